@@ -0,0 +1,398 @@
+#include <dremini/ClientResponseCache.hpp>
+#include <dremini/GeminiUrl.hpp>
+#include <trantor/utils/Logger.h>
+#include <trantor/utils/SerialTaskQueue.h>
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+using namespace drogon;
+
+namespace dremini
+{
+namespace
+{
+// Stable across runs, unlike std::hash, so disk entries can be found again.
+std::uint64_t fnv1a(std::string_view data)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (const auto c : data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void appendLowercase(std::string& out, std::string_view text)
+{
+    for (const auto c : text)
+        out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+bool isSuccess(const HttpResponsePtr& response)
+{
+    if (!response)
+        return false;
+    const auto& status = response->getHeader("gemini-status");
+    return !status.empty() && status[0] == '2';
+}
+
+std::int64_t toUnixSeconds(ClientResponseCache::Clock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+
+// Disk entries hold the key, the time stored, the status line and the body:
+// "<key>\n<unix seconds>\n<status> <meta>\n<body>"
+struct DiskEntry
+{
+    ClientResponseCache::Clock::time_point stored;
+    HttpResponsePtr response;
+};
+
+std::optional<DiskEntry> readDiskEntry(const std::string& path, const std::string& key)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::string storedKey, stored, status;
+    if (!std::getline(in, storedKey) || storedKey != key || !std::getline(in, stored) || !std::getline(in, status))
+        return std::nullopt;
+    if (status.size() < 3 || status[2] != ' ')
+        return std::nullopt;
+    std::string body((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    try
+    {
+        const auto seconds = std::chrono::seconds(std::stoll(stored));
+        return DiskEntry{ClientResponseCache::Clock::time_point(seconds),
+                         internal::makeGeminiResponse(std::stoi(status.substr(0, 2)), status.substr(3), std::move(body))};
+    }
+    catch (const std::exception&)
+    {
+        return std::nullopt;
+    }
+}
+}  // namespace
+
+ClientResponseCache::ClientResponseCache(ClientCacheOptions options)
+    : options_(std::move(options)), diskCompletionLoop_(options_.diskCompletionLoop)
+{
+    if (options_.diskDirectory.empty())
+        return;
+    disk_ = std::make_unique<trantor::SerialTaskQueue>("ClientResponseCache");
+    if (!diskCompletionLoop_)
+        diskCompletionLoop_ = app().getLoop();
+}
+
+ClientResponseCache::~ClientResponseCache()
+{
+    flush();
+}
+
+std::optional<std::string> ClientResponseCache::normaliseUrl(std::string_view url)
+{
+    const auto parsed = parseGeminiUrl(url);
+    if (!parsed || !parsed->hasScheme("gemini"))
+        return std::nullopt;
+    std::string key;
+    key.reserve(url.size() + 1);
+    appendLowercase(key, parsed->scheme);
+    key += "://";
+    if (parsed->ipv6Host)
+        key += '[';
+    appendLowercase(key, parsed->host);
+    if (parsed->ipv6Host)
+        key += ']';
+    if (parsed->portOr(1965) != 1965)
+        key.append(":").append(std::to_string(parsed->portNumber));
+    if (parsed->path.empty())
+        key += '/';
+    else
+        key += parsed->path;
+    if (parsed->hasQuery)
+        key.append("?").append(parsed->query);
+    return key;
+}
+
+void ClientResponseCache::get(const std::string& url,
+                              const CachePolicy& policy,
+                              Fetch fetch,
+                              Callback callback,
+                              Clock::time_point now)
+{
+    const auto key = normaliseUrl(url);
+    if (!key)
+    {
+        fetch(url, std::move(callback));
+        return;
+    }
+
+    HttpResponsePtr hit;
+    bool revalidate = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const auto entry = entries_.find(*key);
+        if (entry != entries_.end())
+        {
+            const auto age = now - entry->second.stored;
+            if (age <= policy.maxAge)
+            {
+                stats_.hits++;
+                hit = entry->second.response;
+            }
+            else if (age <= policy.maxAge + policy.staleWhileRevalidate)
+            {
+                stats_.staleHits++;
+                hit = entry->second.response;
+                // Unless a fetch is already refreshing it
+                revalidate = inFlight_.emplace(*key, std::vector<Callback>{}).second;
+                if (revalidate)
+                    stats_.revalidations++;
+            }
+            else
+            {
+                erase(entry);
+            }
+            if (hit)
+                lru_.splice(lru_.begin(), lru_, entry->second.use);
+        }
+
+        if (!hit)
+        {
+            const auto pending = inFlight_.find(*key);
+            if (pending != inFlight_.end())
+            {
+                stats_.coalesced++;
+                pending->second.push_back(std::move(callback));
+                return;
+            }
+            inFlight_[*key].push_back(std::move(callback));
+            if (!disk_)
+                stats_.misses++;
+        }
+    }
+
+    if (hit)
+    {
+        callback(ReqResult::Ok, hit);
+        if (revalidate)
+            startFetch(*key, url, fetch, now);
+        return;
+    }
+    if (disk_)
+    {
+        // The destructor waits for disk tasks, so they need not own the cache
+        disk_->runTaskInQueue([this, key = *key, url, policy, fetch = std::move(fetch), now]() {
+            readFromDisk(key, url, policy, fetch, now);
+        });
+        return;
+    }
+    startFetch(*key, url, fetch, now);
+}
+
+void ClientResponseCache::readFromDisk(const std::string& key,
+                                       const std::string& url,
+                                       const CachePolicy& policy,
+                                       const Fetch& fetch,
+                                       Clock::time_point now)
+{
+    auto entry = readDiskEntry(diskPath(key), key);
+    // Null while the destructor waits for this task; nobody else can drop
+    // the cache then, so the waiters are failed right here.
+    auto self = weak_from_this().lock();
+    if (!self)
+    {
+        complete(key, ReqResult::NetworkFailure, nullptr, now, false);
+        return;
+    }
+    HttpResponsePtr response;
+    Clock::time_point stored;
+    if (entry)
+    {
+        response = std::move(entry->response);
+        stored = entry->stored;
+    }
+    // `self` is moved along, so its last reference is never dropped here
+    diskCompletionLoop_->queueInLoop([self = std::move(self), key, url, policy, fetch, now, response, stored]() {
+        self->finishDiskRead(key, url, policy, fetch, now, response, stored);
+    });
+}
+
+void ClientResponseCache::finishDiskRead(const std::string& key,
+                                         const std::string& url,
+                                         const CachePolicy& policy,
+                                         const Fetch& fetch,
+                                         Clock::time_point now,
+                                         const HttpResponsePtr& response,
+                                         Clock::time_point stored)
+{
+    if (!response || now - stored > policy.maxAge + policy.staleWhileRevalidate)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.misses++;
+        }
+        startFetch(key, url, fetch, now);
+        return;
+    }
+
+    complete(key, ReqResult::Ok, response, stored, true);
+    if (now - stored <= policy.maxAge)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!inFlight_.emplace(key, std::vector<Callback>{}).second)
+            return;
+        stats_.revalidations++;
+    }
+    startFetch(key, url, fetch, now);
+}
+
+void ClientResponseCache::startFetch(const std::string& key, const std::string& url, const Fetch& fetch, Clock::time_point now)
+{
+    // Null when the cache is being destroyed
+    auto self = weak_from_this().lock();
+    if (!self)
+    {
+        complete(key, ReqResult::NetworkFailure, nullptr, now, false);
+        return;
+    }
+    // Responses are as old as the request that fetched them
+    fetch(url, [self = std::move(self), key, now](ReqResult result, const HttpResponsePtr& response) {
+        self->complete(key, result, response, now, false);
+    });
+}
+
+void ClientResponseCache::complete(const std::string& key,
+                                   ReqResult result,
+                                   const HttpResponsePtr& response,
+                                   Clock::time_point stored,
+                                   bool fromDisk)
+{
+    std::vector<Callback> waiters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto pending = inFlight_.find(key);
+        if (pending != inFlight_.end())
+        {
+            waiters = std::move(pending->second);
+            inFlight_.erase(pending);
+        }
+        if (fromDisk)
+            stats_.diskHits++;
+        // A revalidation that failed to connect keeps serving the stale
+        // response; one answered with an error drops it.
+        if (result == ReqResult::Ok && isSuccess(response))
+        {
+            store(key, response, stored);
+        }
+        else if (result == ReqResult::Ok)
+        {
+            const auto entry = entries_.find(key);
+            if (entry != entries_.end())
+                erase(entry);
+        }
+    }
+
+    if (disk_ && !fromDisk && result == ReqResult::Ok && isSuccess(response))
+    {
+        std::string contents = key;
+        contents.append("\n").append(std::to_string(toUnixSeconds(stored))).append("\n");
+        contents.append(response->getHeader("gemini-status")).append(" ").append(response->getHeader("meta"));
+        contents.append("\n").append(response->body());
+        disk_->runTaskInQueue([path = diskPath(key), contents = std::move(contents)]() {
+            const auto temporary = path + ".tmp";
+            {
+                std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+                out << contents << std::flush;
+                if (!out)
+                {
+                    LOG_ERROR << "Failed to write " << temporary;
+                    return;
+                }
+            }
+            // Readers never see a partly written entry
+            if (std::rename(temporary.c_str(), path.c_str()) != 0)
+                LOG_ERROR << "Failed to replace " << path;
+        });
+    }
+
+    for (const auto& waiter : waiters)
+        waiter(result, response);
+}
+
+void ClientResponseCache::store(const std::string& key, const HttpResponsePtr& response, Clock::time_point stored)
+{
+    const auto existing = entries_.find(key);
+    if (existing != entries_.end())
+        erase(existing);
+
+    const auto bytes = key.size() + response->body().size() + response->getHeader("meta").size();
+    if (bytes > options_.maxBytes)
+        return;
+    while (bytes_ + bytes > options_.maxBytes)
+    {
+        erase(entries_.find(lru_.back()));
+        stats_.evictions++;
+    }
+    lru_.push_front(key);
+    entries_[key] = Entry{response, stored, bytes, lru_.begin()};
+    bytes_ += bytes;
+}
+
+void ClientResponseCache::erase(std::unordered_map<std::string, Entry>::iterator entry)
+{
+    bytes_ -= entry->second.bytes;
+    lru_.erase(entry->second.use);
+    entries_.erase(entry);
+}
+
+std::string ClientResponseCache::diskPath(const std::string& key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.gemini", static_cast<unsigned long long>(fnv1a(key)));
+    return options_.diskDirectory + "/" + name;
+}
+
+void ClientResponseCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    bytes_ = 0;
+}
+
+ClientCacheStats ClientResponseCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::size_t ClientResponseCache::sizeBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+void ClientResponseCache::flush()
+{
+    if (disk_)
+        disk_->waitAllTasksFinished();
+}
+
+void sendCachedRequest(const std::string& url, const HttpReqCallback& callback
+    , const std::shared_ptr<ClientResponseCache>& cache, CachePolicy policy, double timeout
+    , trantor::EventLoop* loop, intmax_t maxBodySize, ServerTrust trust, std::shared_ptr<GeminiClientContext> context)
+{
+    cache->get(url, policy,
+        [timeout, loop, maxBodySize, trust = std::move(trust), context = std::move(context)](
+            const std::string& url, ClientResponseCache::Callback done) {
+            sendRequest(url, done, timeout, loop, maxBodySize, {}, 0, trust, context);
+        },
+        [loop, callback](ReqResult result, const HttpResponsePtr& response) {
+            loop->runInLoop([callback, result, response]() { callback(result, response); });
+        });
+}
+}  // namespace dremini
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <dremini/GeminiClient.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace trantor
+{
+class SerialTaskQueue;
+}
+
+namespace dremini
+{
+struct ClientCacheOptions
+{
+    // Bytes of responses kept in memory. Least recently used responses are
+    // dropped beyond this.
+    std::size_t maxBytes = 64 * 1024 * 1024;
+    // Directory of the optional on-disk tier. Every cached response is also
+    // written there, and memory misses are looked up there before going to
+    // the network, so the cache survives restarts. Not bounded in size.
+    std::string diskDirectory;
+    // Loop that finishes disk reads: callbacks and fetches never run on the
+    // disk thread, where dropping the last reference to the cache would
+    // deadlock its destructor. Null means Drogon's main loop.
+    trantor::EventLoop* diskCompletionLoop = nullptr;
+};
+
+// Gemini has no cache headers, so freshness is up to each request.
+struct CachePolicy
+{
+    // A cached response younger than this is served without a request.
+    std::chrono::seconds maxAge{300};
+    // For this long past maxAge the cached response is still served, and
+    // refreshed in the background.
+    std::chrono::seconds staleWhileRevalidate{0};
+};
+
+struct ClientCacheStats
+{
+    std::uint64_t hits = 0;
+    // Served past maxAge while being revalidated
+    std::uint64_t staleHits = 0;
+    std::uint64_t diskHits = 0;
+    // Requests that went to the network
+    std::uint64_t misses = 0;
+    // Requests that joined a fetch already in flight for the same URL
+    std::uint64_t coalesced = 0;
+    std::uint64_t revalidations = 0;
+    std::uint64_t evictions = 0;
+};
+
+// Thread-safe cache of successful (2x) responses, keyed by normalised URL.
+// Concurrent requests for a URL that is not cached share a single fetch.
+// Must be owned by a shared_ptr.
+class ClientResponseCache : public std::enable_shared_from_this<ClientResponseCache>
+{
+public:
+    using Clock = std::chrono::system_clock;
+    using Callback = drogon::HttpReqCallback;
+    // Requests `url` and calls `done` exactly once, on any thread.
+    using Fetch = std::function<void(const std::string& url, Callback done)>;
+
+    explicit ClientResponseCache(ClientCacheOptions options = {});
+    ~ClientResponseCache();
+    ClientResponseCache(const ClientResponseCache&) = delete;
+    ClientResponseCache& operator=(const ClientResponseCache&) = delete;
+
+    // Calls `callback` at once on a hit. Otherwise it is called on the thread
+    // completing the fetch, or on the disk completion loop after a disk hit.
+    // Responses are shared between callers and must not be modified.
+    void get(const std::string& url,
+             const CachePolicy& policy,
+             Fetch fetch,
+             Callback callback,
+             Clock::time_point now = Clock::now());
+    // Drops the responses in memory. The disk tier is left alone.
+    void clear();
+    ClientCacheStats stats() const;
+    std::size_t sizeBytes() const;
+    // Blocks until pending disk writes are done.
+    void flush();
+
+    // Lowercase scheme and host, no default port, "/" for an empty path and
+    // no fragment. std::nullopt for URLs that cannot be cached.
+    static std::optional<std::string> normaliseUrl(std::string_view url);
+
+private:
+    struct Entry
+    {
+        drogon::HttpResponsePtr response;
+        Clock::time_point stored;
+        std::size_t bytes;
+        // Position in lru_
+        std::list<std::string>::iterator use;
+    };
+
+    void startFetch(const std::string& key, const std::string& url, const Fetch& fetch, Clock::time_point now);
+    // On the disk thread
+    void readFromDisk(const std::string& key, const std::string& url, const CachePolicy& policy, const Fetch& fetch,
+                      Clock::time_point now);
+    // On the disk completion loop, with what readFromDisk() found
+    void finishDiskRead(const std::string& key, const std::string& url, const CachePolicy& policy, const Fetch& fetch,
+                        Clock::time_point now, const drogon::HttpResponsePtr& response, Clock::time_point stored);
+    // Hands the outcome to the requests waiting on `key`
+    void complete(const std::string& key, drogon::ReqResult result, const drogon::HttpResponsePtr& response,
+                  Clock::time_point stored, bool fromDisk);
+    // Expects mutex_ held
+    void store(const std::string& key, const drogon::HttpResponsePtr& response, Clock::time_point stored);
+    void erase(std::unordered_map<std::string, Entry>::iterator entry);
+    std::string diskPath(const std::string& key) const;
+
+    const ClientCacheOptions options_;
+    // Runs disk reads and writes in order, off the event loops
+    std::unique_ptr<trantor::SerialTaskQueue> disk_;
+    trantor::EventLoop* diskCompletionLoop_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    // Most recently used first
+    std::list<std::string> lru_;
+    std::size_t bytes_ = 0;
+    std::unordered_map<std::string, std::vector<Callback>> inFlight_;
+    ClientCacheStats stats_;
+};
+
+/**
+ * @brief Send a request through `cache`. The callback runs on `loop`, even on
+ *        a hit.
+ */
+void sendCachedRequest(const std::string& url, const drogon::HttpReqCallback& callback
+    , const std::shared_ptr<ClientResponseCache>& cache, CachePolicy policy = {}, double timeout = 0
+    , trantor::EventLoop* loop=drogon::app().getLoop(), intmax_t maxBodySize = -1
+    , ServerTrust trust = kNoVerification, std::shared_ptr<GeminiClientContext> context = nullptr);
+
+#ifdef __cpp_impl_coroutine
+namespace internal
+{
+struct [[nodiscard]] CachedRespAwaiter
+{
+    // `send` issues the request with the callback it is given
+    explicit CachedRespAwaiter(std::function<void(drogon::HttpReqCallback)> send) : send_(std::move(send))
+    {
+    }
+
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        send_([state = state_, handle](drogon::ReqResult res, const drogon::HttpResponsePtr& resp) {
+            if (res == drogon::ReqResult::Ok)
+                state->response = resp;
+            else
+                state->exception = std::make_exception_ptr(std::runtime_error(reqResultReason(res)));
+            handle.resume();
+        });
+    }
+
+    drogon::HttpResponsePtr await_resume()
+    {
+        if (state_->exception)
+            std::rethrow_exception(state_->exception);
+        return std::move(state_->response);
+    }
+
+private:
+    struct State
+    {
+        drogon::HttpResponsePtr response;
+        std::exception_ptr exception;
+    };
+    std::function<void(drogon::HttpReqCallback)> send_;
+    std::shared_ptr<State> state_ = std::make_shared<State>();
+};
+}
+
+inline internal::CachedRespAwaiter sendCachedRequestCoro(const std::string& url
+    , std::shared_ptr<ClientResponseCache> cache, CachePolicy policy = {}, double timeout = 10
+    , trantor::EventLoop* loop=drogon::app().getLoop(), intmax_t maxBodySize = -1
+    , ServerTrust trust = kNoVerification, std::shared_ptr<GeminiClientContext> context = nullptr)
+{
+    return internal::CachedRespAwaiter([=](drogon::HttpReqCallback callback) {
+        sendCachedRequest(url, callback, cache, policy, timeout, loop, maxBodySize, trust, context);
+    });
+}
+#endif
+}  // namespace dremini
@@ -0,0 +1,104 @@
+#include <dremini/DnsCache.hpp>
+
+#include <utility>
+
+namespace dremini
+{
+namespace
+{
+// trantor's resolvers report a failed lookup as a default-constructed
+// address, which is 0.0.0.0 but not isUnspecified().
+bool isFailedLookup(const trantor::InetAddress& address)
+{
+    return !address.isIpV6() && address.ipNetEndian() == 0;
+}
+}  // namespace
+
+DnsCache::DnsCache(DnsCacheOptions options, Lookup lookup)
+    : options_(std::move(options)), lookup_(std::move(lookup))
+{
+}
+
+void DnsCache::resolve(const std::string& host, Callback callback, Clock::time_point now)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const auto entry = entries_.find(host);
+        if (entry != entries_.end())
+        {
+            if (entry->second.expires > now)
+            {
+                if (entry->second.failed)
+                    stats_.negativeHits++;
+                else
+                    stats_.hits++;
+                lru_.splice(lru_.begin(), lru_, entry->second.use);
+                const auto address = entry->second.address;
+                lock.unlock();
+                callback(address);
+                return;
+            }
+            lru_.erase(entry->second.use);
+            entries_.erase(entry);
+        }
+
+        const auto pending = inFlight_.find(host);
+        if (pending != inFlight_.end())
+        {
+            stats_.coalesced++;
+            pending->second.push_back(std::move(callback));
+            return;
+        }
+        stats_.misses++;
+        inFlight_[host].push_back(std::move(callback));
+    }
+
+    // TTLs count from the request, which only errs on the side of expiring
+    // early.
+    lookup_(host, [this, host, now](const trantor::InetAddress& address) { complete(host, address, now); });
+}
+
+void DnsCache::complete(const std::string& host, const trantor::InetAddress& address, Clock::time_point now)
+{
+    std::vector<Callback> waiters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto pending = inFlight_.find(host);
+        if (pending != inFlight_.end())
+        {
+            waiters = std::move(pending->second);
+            inFlight_.erase(pending);
+        }
+
+        const bool failed = isFailedLookup(address);
+        if (failed)
+            stats_.failures++;
+        const auto ttl = failed ? options_.negativeTtl : options_.positiveTtl;
+        if (ttl.count() > 0 && options_.maxEntries > 0)
+        {
+            while (entries_.size() >= options_.maxEntries)
+            {
+                entries_.erase(lru_.back());
+                lru_.pop_back();
+                stats_.evictions++;
+            }
+            lru_.push_front(host);
+            entries_[host] = Entry{address, failed, now + ttl, lru_.begin()};
+        }
+    }
+    for (const auto& waiter : waiters)
+        waiter(address);
+}
+
+DnsCacheStats DnsCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::size_t DnsCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+}  // namespace dremini
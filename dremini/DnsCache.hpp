@@ -0,0 +1,84 @@
+#pragma once
+
+#include <trantor/net/InetAddress.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dremini
+{
+struct DnsCacheOptions
+{
+    // trantor's resolvers do not report record TTLs, so successful lookups
+    // are kept for a fixed time.
+    std::chrono::seconds positiveTtl{300};
+    // Failed lookups are remembered too, so retries against a dead host do
+    // not hit the resolver again.
+    std::chrono::seconds negativeTtl{30};
+    // Least recently used hosts are dropped beyond this.
+    std::size_t maxEntries = 10000;
+    // Seconds before the resolver gives up on a lookup.
+    std::size_t resolverTimeout = 10;
+};
+
+struct DnsCacheStats
+{
+    std::uint64_t hits = 0;
+    std::uint64_t negativeHits = 0;
+    std::uint64_t misses = 0;
+    // Lookups that joined one already in flight for the same host.
+    std::uint64_t coalesced = 0;
+    std::uint64_t failures = 0;
+    std::uint64_t evictions = 0;
+};
+
+// Thread-safe cache in front of a resolver. Concurrent lookups of a host that
+// is not cached share a single resolver query.
+class DnsCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void(const trantor::InetAddress&)>;
+    // Resolves `host` uncached and calls `done` exactly once, on any thread.
+    // Failure is reported as a default-constructed address, as trantor's
+    // resolvers do.
+    using Lookup = std::function<void(const std::string& host, Callback done)>;
+
+    DnsCache(DnsCacheOptions options, Lookup lookup);
+
+    // Calls `callback` at once on a hit. Otherwise it is called on the
+    // thread completing the lookup.
+    void resolve(const std::string& host, Callback callback, Clock::time_point now = Clock::now());
+    DnsCacheStats stats() const;
+    std::size_t size() const;
+    const DnsCacheOptions& options() const { return options_; }
+
+private:
+    struct Entry
+    {
+        trantor::InetAddress address;
+        bool failed;
+        Clock::time_point expires;
+        // Position in lru_
+        std::list<std::string>::iterator use;
+    };
+
+    void complete(const std::string& host, const trantor::InetAddress& address, Clock::time_point now);
+
+    DnsCacheOptions options_;
+    Lookup lookup_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    // Most recently used first
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, std::vector<Callback>> inFlight_;
+    DnsCacheStats stats_;
+};
+}  // namespace dremini
@@ -0,0 +1,242 @@
+#include <dremini/GeminiBatch.hpp>
+#include <dremini/GeminiUrl.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using namespace drogon;
+
+namespace dremini
+{
+namespace
+{
+const std::shared_ptr<trantor::EventLoopThreadPool>& defaultBatchPool()
+{
+    // Never destroyed, like the default client context whose resolvers run
+    // on these loops.
+    static const auto* pool = []() {
+        const auto threads = std::max(1U, std::thread::hardware_concurrency());
+        auto created = std::make_shared<trantor::EventLoopThreadPool>(threads, "GeminiBatchLoop");
+        created->start();
+        return new std::shared_ptr<trantor::EventLoopThreadPool>(std::move(created));
+    }();
+    return *pool;
+}
+
+class Batch : public std::enable_shared_from_this<Batch>
+{
+public:
+    Batch(std::vector<std::string> urls, BatchResultCallback onResult, BatchDoneCallback onDone, BatchOptions options)
+        : urls_(std::move(urls))
+        , onResult_(std::move(onResult))
+        , onDone_(std::move(onDone))
+        , options_(std::move(options))
+        , loops_((options_.pool ? options_.pool : defaultBatchPool())->getLoops())
+        , attempts_(urls_.size(), 0)
+    {
+        options_.maxInFlight = std::max<std::size_t>(options_.maxInFlight, 1);
+        options_.maxInFlightPerHost = std::max<std::size_t>(options_.maxInFlightPerHost, 1);
+        stats_.requests = urls_.size();
+        remaining_ = urls_.size();
+    }
+
+    void start()
+    {
+        start_ = std::chrono::steady_clock::now();
+        std::vector<std::size_t> invalid;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(std::size_t index = 0; index < urls_.size(); index++)
+            {
+                const auto url = parseGeminiUrl(urls_[index]);
+                if(!url || !url->hasScheme("gemini") || url->portOr(1965) == 0)
+                {
+                    invalid.push_back(index);
+                    continue;
+                }
+                auto& host = hosts_[std::string(url->host)];
+                if(host.queue.empty())
+                    readyHosts_.push_back(std::string(url->host));
+                host.queue.push_back(index);
+            }
+        }
+        for(const auto index : invalid)
+            finish(index, ReqResult::BadServerAddress, nullptr);
+        schedule();
+    }
+
+private:
+    struct Host
+    {
+        std::deque<std::size_t> queue;
+        std::size_t inFlight = 0;
+        bool slowedDown = false;
+    };
+    struct Start
+    {
+        std::size_t index;
+        std::string host;
+    };
+
+    // Whether `host` may take another request. Expects the lock held.
+    bool canStart(const Host& host) const
+    {
+        return !host.queue.empty() && !host.slowedDown && host.inFlight < options_.maxInFlightPerHost;
+    }
+
+    // Starts as many queued requests as the limits allow, taking hosts in
+    // turn so one large host cannot starve the others.
+    void schedule()
+    {
+        std::vector<Start> starts;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while(inFlight_ < options_.maxInFlight && !readyHosts_.empty())
+            {
+                auto name = std::move(readyHosts_.front());
+                readyHosts_.pop_front();
+                auto& host = hosts_[name];
+                // Hosts are queued again whenever they may have become
+                // ready, so stale entries are simply skipped.
+                if(!canStart(host))
+                    continue;
+                starts.push_back({host.queue.front(), name});
+                host.queue.pop_front();
+                host.inFlight++;
+                inFlight_++;
+                if(canStart(host))
+                    readyHosts_.push_back(std::move(name));
+            }
+        }
+        for(auto& start : starts)
+            send(start.index, std::move(start.host));
+    }
+
+    void send(std::size_t index, std::string host)
+    {
+        auto loop = loops_[nextLoop_.fetch_add(1, std::memory_order_relaxed) % loops_.size()];
+        auto self = shared_from_this();
+        dremini::sendRequest(urls_[index],
+            [self, index, host = std::move(host), loop](ReqResult result, const HttpResponsePtr& resp) {
+                self->onResponse(index, host, loop, result, resp);
+            },
+            options_.timeout, loop, options_.maxBodySize, options_.mimes, options_.maxTransferDuration,
+            options_.trust, options_.context);
+    }
+
+    void onResponse(std::size_t index, const std::string& name, trantor::EventLoop* loop,
+                    ReqResult result, const HttpResponsePtr& resp)
+    {
+        const bool slowDown = result == ReqResult::Ok && resp->getHeader("gemini-status") == "44";
+        bool retry = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& host = hosts_[name];
+            host.inFlight--;
+            inFlight_--;
+            if(slowDown)
+            {
+                stats_.slowDowns++;
+                retry = attempts_[index] < options_.maxSlowDownRetries;
+                if(retry)
+                {
+                    attempts_[index]++;
+                    stats_.retries++;
+                    host.queue.push_front(index);
+                }
+                if(!host.slowedDown)
+                {
+                    host.slowedDown = true;
+                    const auto delay = slowDownSeconds(resp->getHeader("meta"));
+                    loop->runAfter(delay, [self = shared_from_this(), name]() {
+                        {
+                            std::lock_guard<std::mutex> lock(self->mutex_);
+                            self->hosts_[name].slowedDown = false;
+                            self->readyHosts_.push_back(name);
+                        }
+                        self->schedule();
+                    });
+                }
+            }
+            else if(canStart(host))
+            {
+                readyHosts_.push_back(name);
+            }
+        }
+        if(!retry)
+            finish(index, result, resp);
+        schedule();
+    }
+
+    double slowDownSeconds(const std::string& meta) const
+    {
+        char* end = nullptr;
+        const auto seconds = std::strtod(meta.c_str(), &end);
+        if(end == meta.c_str() || !(seconds >= 0))
+            return options_.defaultSlowDownSeconds;
+        return std::min(seconds, options_.maxSlowDownSeconds);
+    }
+
+    void finish(std::size_t index, ReqResult result, const HttpResponsePtr& resp)
+    {
+        if(onResult_)
+            onResult_(BatchResult{index, urls_[index], result, resp});
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(result == ReqResult::Ok)
+            {
+                stats_.succeeded++;
+                stats_.bodyBytes += resp->body().size();
+            }
+            else
+            {
+                stats_.failed++;
+            }
+            done = --remaining_ == 0;
+            if(done)
+                stats_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+        if(done && onDone_)
+            onDone_(stats_);
+    }
+
+    const std::vector<std::string> urls_;
+    const BatchResultCallback onResult_;
+    const BatchDoneCallback onDone_;
+    BatchOptions options_;
+    const std::vector<trantor::EventLoop*> loops_;
+    std::atomic<std::size_t> nextLoop_{0};
+    std::chrono::steady_clock::time_point start_;
+
+    // Guards everything below
+    std::mutex mutex_;
+    std::unordered_map<std::string, Host> hosts_;
+    std::deque<std::string> readyHosts_;
+    std::vector<std::size_t> attempts_;
+    std::size_t inFlight_ = 0;
+    std::size_t remaining_ = 0;
+    BatchStats stats_;
+};
+}  // namespace
+
+void sendBatchRequest(std::vector<std::string> urls,
+                      BatchResultCallback onResult,
+                      BatchDoneCallback onDone,
+                      BatchOptions options)
+{
+    if(urls.empty())
+    {
+        if(onDone)
+            onDone(BatchStats{});
+        return;
+    }
+    std::make_shared<Batch>(std::move(urls), std::move(onResult), std::move(onDone), std::move(options))->start();
+}
+}  // namespace dremini
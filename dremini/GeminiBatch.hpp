@@ -0,0 +1,128 @@
+#pragma once
+
+#include <dremini/GeminiClient.hpp>
+#include <trantor/net/EventLoopThreadPool.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dremini
+{
+struct BatchOptions
+{
+    // Requests in flight across the whole batch.
+    std::size_t maxInFlight = 64;
+    // Requests in flight to any one host.
+    std::size_t maxInFlightPerHost = 2;
+    double timeout = 10;
+    intmax_t maxBodySize = 0x2000000;
+    double maxTransferDuration = 0;
+    std::vector<std::string> mimes;
+    // A 44 (Slow Down) response pauses its host for the number of seconds in
+    // its meta, or defaultSlowDownSeconds if the meta is not a number, capped
+    // at maxSlowDownSeconds. The request is then retried up to
+    // maxSlowDownRetries times before its 44 is reported.
+    double defaultSlowDownSeconds = 30;
+    double maxSlowDownSeconds = 600;
+    std::size_t maxSlowDownRetries = 2;
+    ServerTrust trust = kNoVerification;
+    std::shared_ptr<GeminiClientContext> context;
+    // Loops the requests are spread over. Defaults to a process-wide pool
+    // with one loop per hardware thread.
+    std::shared_ptr<trantor::EventLoopThreadPool> pool;
+};
+
+struct BatchResult
+{
+    // Position of the URL in the batch.
+    std::size_t index = 0;
+    std::string url;
+    drogon::ReqResult result = drogon::ReqResult::Ok;
+    drogon::HttpResponsePtr response;
+};
+
+struct BatchStats
+{
+    std::size_t requests = 0;
+    std::size_t succeeded = 0;
+    std::size_t failed = 0;
+    // 44 responses received, including those that were retried.
+    std::size_t slowDowns = 0;
+    std::size_t retries = 0;
+    std::size_t bodyBytes = 0;
+    double seconds = 0;
+};
+
+// Called once per URL, concurrently from the pool's loops.
+using BatchResultCallback = std::function<void(const BatchResult&)>;
+// Called once after the last result.
+using BatchDoneCallback = std::function<void(const BatchStats&)>;
+
+/**
+ * @brief Fetch `urls` in parallel within the limits of `options`. Invalid URLs
+ *        are reported as BadServerAddress without being sent.
+ */
+void sendBatchRequest(std::vector<std::string> urls,
+                      BatchResultCallback onResult,
+                      BatchDoneCallback onDone = nullptr,
+                      BatchOptions options = {});
+
+#ifdef __cpp_impl_coroutine
+namespace internal
+{
+struct [[nodiscard]] GeminiBatchAwaiter
+{
+    GeminiBatchAwaiter(std::vector<std::string> urls, BatchOptions options)
+        : urls_(std::move(urls)), options_(std::move(options))
+    {
+    }
+
+    bool await_ready() noexcept
+    {
+        return urls_.empty();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        auto state = state_;
+        state->results.resize(urls_.size());
+        sendBatchRequest(std::move(urls_),
+            [state](const BatchResult& result) {
+                // Every index is written exactly once, by one thread
+                state->results[result.index] = result;
+            },
+            [state, handle](const BatchStats&) { handle.resume(); },
+            std::move(options_));
+    }
+
+    std::vector<BatchResult> await_resume()
+    {
+        return std::move(state_->results);
+    }
+
+private:
+    struct State
+    {
+        std::vector<BatchResult> results;
+    };
+
+    std::vector<std::string> urls_;
+    BatchOptions options_;
+    std::shared_ptr<State> state_ = std::make_shared<State>();
+};
+}
+
+/**
+ * @brief Fetch `urls` in parallel and resume with every result, in the order
+ *        of `urls`, once all of them are done.
+ */
+inline internal::GeminiBatchAwaiter sendBatchRequestCoro(std::vector<std::string> urls, BatchOptions options = {})
+{
+    return internal::GeminiBatchAwaiter(std::move(urls), std::move(options));
+}
+#endif
+}  // namespace dremini
@@ -1,15 +1,16 @@
 #include <dremini/GeminiClient.hpp>
+#include <dremini/GeminiUrl.hpp>
 #include <trantor/net/TcpClient.h>
-#include <trantor/net/Resolver.h>
 #include <trantor/utils/MsgBuffer.h>
 
-#include <regex>
+#include <cstring>
 #include <string>
 #include <sstream>
 #include <algorithm>
 #include <random>
-#include <list>
 #include <atomic>
+#include <cctype>
+#include <utility>
 
 using namespace drogon;
 
@@ -55,19 +56,12 @@ static ContentType parseContentType(const std::string_view &contentType)
     return iter->second;
 }
 
-static std::optional<int> try_stoi(const std::string_view sv)
+// A response header is at most 1024 bytes, followed by CRLF
+static constexpr std::size_t kMaxHeaderLine = 1024 + 2;
+
+static bool isDigit(char c)
 {
-    try
-    {
-        size_t pos = 0;
-        return std::stoi(sv.data(), &pos);
-        if(pos != sv.size())
-            return std::nullopt;
-    }
-    catch (const std::exception &e)
-    {
-        return std::nullopt;
-    }
+    return c >= '0' && c <= '9';
 }
 
 namespace dremini
@@ -76,46 +70,85 @@ namespace internal
 {
 
 GeminiClient::GeminiClient(std::string url, trantor::EventLoop* loop, double timeout, intmax_t maxBodySize, double maxTransferDuration,
-                           ServerTrust trust)
+                           ServerTrust trust, std::shared_ptr<GeminiClientContext> context)
     : loop_(loop), timeout_(timeout), maxBodySize_(maxBodySize), maxTransferDuration_(maxTransferDuration), trust_(std::move(trust))
+    , context_(context ? std::move(context) : defaultClientContext())
 {
-    static const std::regex re(R"(([a-z]+):\/\/([^\/:]+)(?:\:([0-9]+))?($|\/.*))");
-    std::smatch match;
-    if(!std::regex_match(url, match, re))
+    const auto parsed = parseGeminiUrl(url);
+    if(!parsed)
         throw std::invalid_argument("request is not a valid Gemini URL");
+    if(!parsed->hasScheme("gemini"))
+        throw std::invalid_argument("Must be a gemini URL");
 
-    std::string protocol = match[1];
-    host_ = match[2];
-    std::string port = match[3];
-    std::string path = match[4];
+    host_ = std::string(parsed->host);
+    port_ = parsed->portOr(1965);
+    if(port_ == 0)
+        throw std::invalid_argument("0 is not a valid port number");
 
-    if(protocol != "gemini")
-        throw std::invalid_argument("Must be a gemini URL");
-    port_ = 1965;
-    if(port.empty() == false)
+    // Gemini requests are always absolute URLs with a non-empty path and
+    // never carry a fragment.
+    const auto authorityEnd = static_cast<std::size_t>(parsed->authority.data() + parsed->authority.size() - url.data());
+    url_.reserve(url.size() + 1);
+    url_.append(url, 0, authorityEnd);
+    if(parsed->path.empty())
+        url_ += '/';
+    else
+        url_ += parsed->path;
+    if(parsed->hasQuery)
     {
-        int portNum = std::stoi(port);
-        if(portNum >= 65536 || portNum <= 0)
-        {
-            LOG_ERROR << port << "is not a valid port number";
-        }
-        port_ = portNum;
+        url_ += '?';
+        url_ += parsed->query;
     }
+}
 
-    if(path.empty() && url.back() != '/')
-        url_ = url + "/";
+drogon::HttpResponsePtr makeGeminiResponse(int status, const std::string& meta, std::string body)
+{
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setBody(std::move(body));
+    resp->addHeader("meta", meta);
+    resp->addHeader("gemini-status", std::to_string(status));
+    int httpStatus;
+    if(status == 20)
+        httpStatus = 200;
+    else if(status == 59)
+        httpStatus = 400;
+    else if(status == 51)
+        httpStatus = 404;
+    else if(status == 43)
+        httpStatus = 504;
+    else if(status == 44)
+        httpStatus = 503;
+    else if(status%10 == 4)
+        httpStatus = 500;
+    else if(status%10 == 5)
+        httpStatus = 400;
     else
-        url_ = url;
-
+        httpStatus = status/10*100 + status%10;
+    resp->setStatusCode((HttpStatusCode)httpStatus);
+    if(status >= 20 && status < 30)
+    {
+        auto end = meta.find(";");
+        if(end == std::string::npos)
+            end = meta.size();
+        std::string_view ct(meta.c_str(), end);
+        resp->setContentTypeCodeAndCustomString(parseContentType(ct), meta);
+        resp->addHeader("content-type", meta);
+    }
+    else
+        resp->setContentTypeCode(CT_NONE);
+    return resp;
 }
 
-static thread_local std::shared_ptr<trantor::Resolver> resolver;
 void GeminiClient::fire()
 {
-    if(isIPString(host_))
+    self_ = shared_from_this();
+    if(addressKnown_ || isIPString(host_))
     {
-        bool isIpV6 = host_.find(":") != std::string::npos;
-        peerAddress_ = trantor::InetAddress(host_, port_, isIpV6);
+        if(!addressKnown_)
+        {
+            bool isIpV6 = host_.find(":") != std::string::npos;
+            peerAddress_ = trantor::InetAddress(host_, port_, isIpV6);
+        }
         if(loop_->isInLoopThread())
             sendRequestInLoop();
         else
@@ -124,9 +157,7 @@ void GeminiClient::fire()
     }
 
     loop_->runInLoop([thisPtr=shared_from_this()](){
-        if(!resolver)
-            resolver = trantor::Resolver::newResolver(thisPtr->loop_, 10);
-        resolver->resolve(thisPtr->host_, [thisPtr](const trantor::InetAddress &addr){
+        thisPtr->context_->resolve(thisPtr->loop_, thisPtr->host_, [thisPtr](const trantor::InetAddress &addr){
             if(addr.ipNetEndian() == 0)
             {
                 thisPtr->haveResult(ReqResult::BadServerAddress, nullptr);
@@ -144,11 +175,26 @@ void GeminiClient::haveResult(drogon::ReqResult result, const trantor::MsgBuffer
     if(callbackCalled_ == true)
         return;
     callbackCalled_ = true;
+    // Destroyed once the trantor callback that got us here has unwound
+    loop_->queueInLoop([self = std::move(self_)]() {});
 
     if(timeout_ > 0)
         loop_->invalidateTimer(timeoutTimerId_);
     if(maxTransferDuration_ > 0)
         loop_->invalidateTimer(transferTimerId_);
+    if(stream_)
+    {
+        client_ = nullptr;
+        if(aborted_)
+            return;
+        if(result == ReqResult::Ok && !headerReceived_)
+            result = ReqResult::BadResponse;
+        if(result == ReqResult::Ok && msg != nullptr && msg->readableBytes() != 0 && stream_->onChunk)
+            stream_->onChunk(std::string_view(msg->peek(), msg->readableBytes()));
+        if(stream_->onComplete)
+            stream_->onComplete(result);
+        return;
+    }
     if(result != ReqResult::Ok)
     {
         client_ = nullptr;
@@ -161,52 +207,84 @@ void GeminiClient::haveResult(drogon::ReqResult result, const trantor::MsgBuffer
         callback_(ReqResult::BadResponse, nullptr);
         return;
     }
+    if(responseStatus_ / 10 == 3 && followRedirect())
+    {
+        client_ = nullptr;
+        return;
+    }
 
     // check ok. now we can get the body
-    auto resp = HttpResponse::newHttpResponse();
-    resp->setBody(std::string(msg->peek(), msg->peek()+msg->readableBytes()));
-    resp->addHeader("meta", resoneseMeta_);
-    resp->addHeader("gemini-status", std::to_string(responseStatus_));
-    int httpStatus;
-    if(responseStatus_ == 20)
-        httpStatus = 200;
-    else if(responseStatus_ == 59)
-        httpStatus = 400;
-    else if(responseStatus_ == 51)
-        httpStatus = 404;
-    else if(responseStatus_ == 43)
-        httpStatus = 504;
-    else if(responseStatus_ == 44)
-        httpStatus = 503;
-    else if(responseStatus_%10 == 4)
-        httpStatus = 500;
-    else if(responseStatus_%10 == 5)
-        httpStatus = 400;
-    else
-        httpStatus = responseStatus_/10*100 + responseStatus_%10;
-    resp->setStatusCode((HttpStatusCode)httpStatus);
-    if(responseStatus_ >= 20 && responseStatus_ < 30)
+    auto resp = makeGeminiResponse(responseStatus_, resoneseMeta_, std::string(msg->peek(), msg->peek()+msg->readableBytes()));
+    if(!redirects_.empty())
     {
-        auto end = resoneseMeta_.find(";");
-        if(end == std::string::npos)
-            end = resoneseMeta_.size();
-        std::string_view ct(resoneseMeta_.c_str(), end);
-        resp->setContentTypeCodeAndCustomString(parseContentType(ct), resoneseMeta_);
-        resp->addHeader("content-type", resoneseMeta_);
+        std::string chain;
+        for(const auto& hop : redirects_)
+        {
+            if(!chain.empty())
+                chain += ' ';
+            chain += hop;
+        }
+        resp->addHeader("gemini-redirects", chain);
     }
-    else
-        resp->setContentTypeCode(CT_NONE);
     // we need the client no more. Let's release this as soon as possible to save open file descriptors
     client_ = nullptr;
     callback_(ReqResult::Ok, resp);
 }
 
+bool GeminiClient::followRedirect()
+{
+    const auto& policy = context_->redirectPolicy();
+    const auto hops = redirects_.empty() ? 0 : redirects_.size() - 1;
+    if(hops >= policy.maxHops)
+        return false;
+    const auto target = resolveGeminiUrl(url_, resoneseMeta_);
+    if(!target)
+        return false;
+
+    std::shared_ptr<GeminiClient> next;
+    try
+    {
+        next = std::make_shared<GeminiClient>(*target, loop_, timeout_, maxBodySize_, maxTransferDuration_, trust_, context_);
+    }
+    catch(const std::invalid_argument&)
+    {
+        // Not a gemini:// URL
+        return false;
+    }
+    const bool sameHost = port_ == next->port_ && std::equal(host_.begin(), host_.end(), next->host_.begin(), next->host_.end(),
+        [](char a, char b) { return std::tolower((unsigned char)a) == std::tolower((unsigned char)b); });
+    if(policy.sameHostOnly && !sameHost)
+        return false;
+    if(next->url_ == url_ || std::find(redirects_.begin(), redirects_.end(), next->url_) != redirects_.end())
+    {
+        LOG_TRACE << "Redirect loop at " << next->url_;
+        return false;
+    }
+    if(redirects_.empty())
+        redirects_.push_back(url_);
+
+    // trantor cannot hand a TLS session to a new connection, but the address
+    // of the same host needs no second lookup.
+    if(sameHost)
+    {
+        next->peerAddress_ = peerAddress_;
+        next->addressKnown_ = true;
+    }
+    next->callback_ = std::move(callback_);
+    next->setMimes(downloadMimes_);
+    next->redirects_ = std::move(redirects_);
+    next->redirects_.push_back(next->url_);
+    next->transferDeadline_ = transferDeadline_;
+    next->fire();
+    return true;
+}
+
 void GeminiClient::sendRequestInLoop()
 {
-    // TODO: Validate certificate
+    // Certificates are checked by trust_ once the handshake completes
     auto weakPtr = weak_from_this();
     client_ = std::make_shared<trantor::TcpClient>(loop_, peerAddress_, "GeminiClient");
-    client_->enableSSL(false, false, host_);
+    client_->enableSSL(context_->tlsPolicy(host_));
     client_->setMessageCallback([weakPtr](const trantor::TcpConnectionPtr &connPtr,
               trantor::MsgBuffer *msg) {
         auto thisPtr = weakPtr.lock();
@@ -223,6 +301,7 @@ void GeminiClient::sendRequestInLoop()
 
         if(connPtr->connected())
         {
+            thisPtr->connection_ = connPtr;
             if (thisPtr->trustStarted_)
                 return;
             const auto certificate = connPtr->peerCertificate();
@@ -317,7 +396,12 @@ void GeminiClient::sendRequestInLoop()
     }
     if(maxTransferDuration_ > 0)
     {
-        transferTimerId_ = loop_->runAfter(maxTransferDuration_, [weakPtr](){
+        const auto now = std::chrono::steady_clock::now();
+        if(!transferDeadline_)
+            transferDeadline_ = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                          std::chrono::duration<double>(maxTransferDuration_));
+        const std::chrono::duration<double> remaining = *transferDeadline_ - now;
+        transferTimerId_ = loop_->runAfter(std::max(remaining.count(), 0.0), [weakPtr](){
             auto thisPtr = weakPtr.lock();
             if(!thisPtr)
                 return;
@@ -336,55 +420,70 @@ void GeminiClient::onRecvMessage(const trantor::TcpConnectionPtr &connPtr,
 
     if(!headerReceived_)
     {
-        const char* crlf = msg->findCRLF();
-        if(crlf == nullptr)
+        // Only the bytes that arrived since the last packet are scanned
+        const auto available = std::min(msg->readableBytes(), kMaxHeaderLine);
+        const auto* lf = static_cast<const char*>(
+            memchr(msg->peek() + headerScanned_, '\n', available - headerScanned_));
+        if(lf == nullptr)
         {
-            if(msg->readableBytes() > 1024) {
+            headerScanned_ = available;
+            if(available == kMaxHeaderLine)
                 haveResult(ReqResult::BadResponse, nullptr);
-                return;
-            }
             return;
         }
         headerReceived_ = true;
 
-        const std::string_view header(msg->peek(), std::distance(msg->peek(), crlf));
+        const std::size_t lineSize = lf - msg->peek() + 1;
+        const std::string_view header(msg->peek(), std::max<std::size_t>(lineSize, 2) - 2);
         LOG_TRACE << "Gemini header is: " << header;
-        if(header.size() < 2 || (header.size() >= 3 && header[2] != ' ') || header.size() > 1024 || header.find('\n') != std::string::npos)
+        if(header.size() < 2 || lf[-1] != '\r' || !isDigit(header[0]) || !isDigit(header[1]) ||
+           (header.size() >= 3 && header[2] != ' '))
         {
             // bad response
             haveResult(ReqResult::BadResponse, nullptr);
             return;
         }
+        responseStatus_ = (header[0] - '0') * 10 + (header[1] - '0');
 
-        auto statusCode = try_stoi(std::string(header.begin(), header.begin()+2));
-        if(statusCode.has_value() == false)
+        std::string_view meta;
+        if(header.size() >= 4)
         {
-            // bad response again
-            haveResult(ReqResult::BadResponse, nullptr);
-            return;
-        }
-        responseStatus_ = statusCode.value();
-        if(header.size() >= 4) {
             // remove leading spaces because some non-compliant servers send them
-            auto meta = header.substr(3);
-            auto idx = meta.find_first_not_of(" \t");
-            if(idx != std::string::npos)
-                resoneseMeta_ = std::string(meta.begin()+idx, meta.end());
-            else
-                resoneseMeta_ = "";
-            resoneseMeta_ = meta;
+            meta = header.substr(3);
+            meta.remove_prefix(std::min(meta.find_first_not_of(" \t"), meta.size()));
         }
-        if(!downloadMimes_.empty() && responseStatus_ / 10 == 2)
+        if(!downloadMimeSet_.empty() && responseStatus_ / 10 == 2)
         {
-            std::string mime = resoneseMeta_.substr(0, resoneseMeta_.find_first_of("; ,"));
-            if(std::find(downloadMimes_.begin(), downloadMimes_.end(), mime) == downloadMimes_.end()) {
-                msg->retrieveAll();
+            const auto mime = meta.substr(0, meta.find_first_of("; ,"));
+            if(downloadMimeSet_.count(mime) == 0) {
                 LOG_TRACE << "Ignoring file of MIME " << mime;
+                resoneseMeta_.assign(meta.data(), meta.size());
+                msg->retrieveAll();
                 connPtr->forceClose(); // this triggers the connection close handler which will call haveResult
                 return;
             }
         }
-        msg->read(std::distance(msg->peek(), crlf)+2);
+        resoneseMeta_.assign(meta.data(), meta.size());
+        msg->retrieve(lineSize);
+        if(stream_ && stream_->onHeader &&
+           !stream_->onHeader(responseStatus_, resoneseMeta_, GeminiStreamHandle(weak_from_this())))
+        {
+            abortStream();
+            return;
+        }
+    }
+
+    if(stream_)
+    {
+        // Hand each chunk over and drop it, so the buffer never holds more
+        // than one read's worth of the body.
+        if(msg->readableBytes() == 0 || callbackCalled_)
+            return;
+        const bool keepGoing = !stream_->onChunk || stream_->onChunk(std::string_view(msg->peek(), msg->readableBytes()));
+        msg->retrieveAll();
+        if(!keepGoing)
+            abortStream();
+        return;
     }
 
     if(maxBodySize_ < 0 || msg->readableBytes() > maxBodySize_)
@@ -396,32 +495,224 @@ void GeminiClient::onRecvMessage(const trantor::TcpConnectionPtr &connPtr,
 }
 
 
+void GeminiClient::pauseStream()
+{
+    loop_->runInLoop([thisPtr = shared_from_this()]() {
+        if(auto connection = thisPtr->connection_.lock())
+            connection->stopRecv();
+    });
+}
+
+void GeminiClient::resumeStream()
+{
+    loop_->runInLoop([thisPtr = shared_from_this()]() {
+        if(auto connection = thisPtr->connection_.lock())
+            connection->startRecv();
+    });
+}
+
+void GeminiClient::abortStream()
+{
+    loop_->runInLoop([thisPtr = shared_from_this()]() {
+        if(thisPtr->callbackCalled_)
+            return;
+        thisPtr->aborted_ = true;
+        if(auto connection = thisPtr->connection_.lock())
+            connection->forceClose();
+        thisPtr->haveResult(ReqResult::Ok, nullptr);
+    });
+}
+
+}
+
+void GeminiStreamHandle::pause() const
+{
+    if(auto client = client_.lock())
+        client->pauseStream();
+}
+
+void GeminiStreamHandle::resume() const
+{
+    if(auto client = client_.lock())
+        client->resumeStream();
+}
+
+void GeminiStreamHandle::abort() const
+{
+    if(auto client = client_.lock())
+        client->abortStream();
+}
+
+void sendStreamRequest(const std::string& url, GeminiStreamCallbacks callbacks, double timeout
+    , trantor::EventLoop* loop, double maxTransferDuration, ServerTrust trust, std::shared_ptr<GeminiClientContext> context)
+{
+    auto client = std::make_shared<::dremini::internal::GeminiClient>(url, loop, timeout, 0, maxTransferDuration,
+                                                                      std::move(trust), std::move(context));
+    client->setStreamCallbacks(std::move(callbacks));
+    client->fire();
 }
 
-static std::list<std::shared_ptr<internal::GeminiClient>> holder;
-static std::mutex holderMutex;
 void sendRequest(const std::string& url, const HttpReqCallback& callback, double timeout
     , trantor::EventLoop* loop, intmax_t maxBodySize, const std::vector<std::string>& mimes
-    , double maxTransferDuration, ServerTrust trust)
+    , double maxTransferDuration, ServerTrust trust, std::shared_ptr<GeminiClientContext> context)
 {
     auto client = std::make_shared<::dremini::internal::GeminiClient>(url, loop, timeout, maxBodySize, maxTransferDuration,
-                                                                      std::move(trust));
-    decltype(holder)::iterator it;
+                                                                      std::move(trust), std::move(context));
+    client->setCallback(callback);
+    client->setMimes(mimes);
+    client->fire();
+}
+
+#ifdef __cpp_impl_coroutine
+namespace
+{
+// Unread bytes beyond which the reader stops reading from the connection
+constexpr std::size_t kMaxQueuedChunkBytes = 1024 * 1024;
+}
+
+namespace internal
+{
+bool StreamHeaderAwaiter::await_ready()
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->headerReceived || state->finished;
+}
+
+bool StreamHeaderAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if(state->headerReceived || state->finished)
+        return false;
+    state->waiter = handle;
+    return true;
+}
+
+std::pair<int, std::string> StreamHeaderAwaiter::await_resume()
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if(!state->headerReceived)
+        throw std::runtime_error(reqResultReason(state->result));
+    return {state->status, state->meta};
+}
+
+bool StreamChunkAwaiter::await_ready()
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return !state->chunks.empty() || state->finished;
+}
+
+bool StreamChunkAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if(!state->chunks.empty() || state->finished)
+        return false;
+    state->waiter = handle;
+    return true;
+}
+
+std::optional<std::string> StreamChunkAwaiter::await_resume()
+{
+    std::optional<std::string> chunk;
+    std::optional<GeminiStreamHandle> resume;
     {
-        std::lock_guard<std::mutex> lock(holderMutex);
-        holder.push_back(client);
-        it = std::prev(holder.end());
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if(state->chunks.empty())
+        {
+            if(state->result != ReqResult::Ok)
+                throw std::runtime_error(reqResultReason(state->result));
+            return std::nullopt;
+        }
+        chunk = std::move(state->chunks.front());
+        state->chunks.pop_front();
+        state->queuedBytes -= chunk->size();
+        if(state->paused && state->queuedBytes < kMaxQueuedChunkBytes / 2)
+        {
+            state->paused = false;
+            resume = state->handle;
+        }
     }
-    client->setCallback([callback, it, loop] (ReqResult result, const HttpResponsePtr& resp) mutable {
-        callback(result, resp);
+    // Outside the lock: on the client's loop, resuming may deliver the next
+    // chunk straight away.
+    if(resume)
+        resume->resume();
+    return chunk;
+}
+}
 
-        std::lock_guard lock(holderMutex);
-        loop->queueInLoop([client = std::move(*it)]() {
-            // client is destroyed here
-        });
-        holder.erase(it);
-    });
-    client->setMimes(mimes);
-    client->fire();
+GeminiChunkReader::~GeminiChunkReader()
+{
+    if(!state_)
+        return;
+    std::optional<GeminiStreamHandle> handle;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if(state_->finished)
+            return;
+        state_->abandoned = true;
+        handle = state_->handle;
+    }
+    if(handle)
+        handle->abort();
+}
+
+GeminiChunkReader sendStreamRequestCoro(const std::string& url, double timeout
+    , trantor::EventLoop* loop, double maxTransferDuration, ServerTrust trust, std::shared_ptr<GeminiClientContext> context)
+{
+    auto state = std::make_shared<internal::ChunkReaderState>();
+    // Every callback resumes the waiting coroutine, if any, once the lock is
+    // released.
+    GeminiStreamCallbacks callbacks;
+    callbacks.onHeader = [state](int status, const std::string& meta, const GeminiStreamHandle& handle) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(state->abandoned)
+                return false;
+            state->headerReceived = true;
+            state->status = status;
+            state->meta = meta;
+            state->handle = handle;
+            waiter = std::exchange(state->waiter, nullptr);
+        }
+        if(waiter)
+            waiter.resume();
+        return true;
+    };
+    callbacks.onChunk = [state](std::string_view chunk) {
+        std::coroutine_handle<> waiter;
+        std::optional<GeminiStreamHandle> pause;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(state->abandoned)
+                return false;
+            state->chunks.emplace_back(chunk);
+            state->queuedBytes += chunk.size();
+            if(!state->paused && state->queuedBytes > kMaxQueuedChunkBytes)
+            {
+                state->paused = true;
+                pause = state->handle;
+            }
+            waiter = std::exchange(state->waiter, nullptr);
+        }
+        if(pause)
+            pause->pause();
+        if(waiter)
+            waiter.resume();
+        return true;
+    };
+    callbacks.onComplete = [state](ReqResult result) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->finished = true;
+            state->result = result;
+            waiter = std::exchange(state->waiter, nullptr);
+        }
+        if(waiter)
+            waiter.resume();
+    };
+    sendStreamRequest(url, std::move(callbacks), timeout, loop, maxTransferDuration, std::move(trust), std::move(context));
+    return GeminiChunkReader(std::move(state));
 }
+#endif
 }
@@ -3,14 +3,20 @@
 #include <drogon/HttpTypes.h>
 #include <drogon/HttpResponse.h>
 #include <drogon/drogon.h>
+#include <dremini/GeminiClientContext.hpp>
 #include <trantor/net/EventLoop.h>
 #include <trantor/net/InetAddress.h>
 #include <trantor/net/callbacks.h>
 
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <unordered_set>
 #include <functional>
 #include <trantor/net/Certificate.h>
 
@@ -39,12 +45,57 @@ inline const ServerTrust kNoVerification =
 
 namespace internal
 {
+class GeminiClient;
+}
+
+/**
+ * @brief Controls a streaming request. Copyable and thread safe; calls made
+ *        after the request finished are ignored.
+ */
+class GeminiStreamHandle
+{
+public:
+    /**
+     * @brief Stop reading from the connection until resume(). TCP flow control
+     *        then slows the server down instead of buffering the body.
+     */
+    void pause() const;
+    void resume() const;
+    /**
+     * @brief Close the connection. onComplete is not called.
+     */
+    void abort() const;
+
+private:
+    friend class internal::GeminiClient;
+    explicit GeminiStreamHandle(std::weak_ptr<internal::GeminiClient> client) : client_(std::move(client)) {}
+    std::weak_ptr<internal::GeminiClient> client_;
+};
+
+struct GeminiStreamCallbacks
+{
+    // Called once with the response header. Return false to abort.
+    std::function<bool(int status, const std::string& meta, const GeminiStreamHandle& handle)> onHeader;
+    // Body bytes as they arrive. The view is only valid during the call.
+    // Return false to abort.
+    std::function<bool(std::string_view chunk)> onChunk;
+    // Called exactly once when the response ended or failed, unless the
+    // request was aborted.
+    std::function<void(drogon::ReqResult result)> onComplete;
+};
+
+namespace internal
+{
+
+// The HTTP response a Gemini response is delivered as: body, `meta` and
+// `gemini-status` headers, and the closest HTTP status and content type.
+drogon::HttpResponsePtr makeGeminiResponse(int status, const std::string& meta, std::string body);
 
 class GeminiClient : public std::enable_shared_from_this<GeminiClient>
 {
 public:
     GeminiClient(std::string url, trantor::EventLoop* loop, double timeout = 0, intmax_t maxBodySize = 0x2000000, double maxTransferDuration = 900,
-                 ServerTrust trust = kNoVerification);
+                 ServerTrust trust = kNoVerification, std::shared_ptr<GeminiClientContext> context = nullptr);
     void fire();
     void setCallback(const drogon::HttpReqCallback& callback)
     {
@@ -65,13 +116,31 @@ public:
     void setMimes(const std::vector<std::string>& mimes)
     {
         downloadMimes_ = mimes;
+        downloadMimeSet_.clear();
+        downloadMimeSet_.insert(downloadMimes_.begin(), downloadMimes_.end());
+    }
+
+    /**
+     * @brief Deliver the response through `callbacks` as it arrives instead of
+     *        buffering it for the HttpReqCallback. The body size limit does
+     *        not apply.
+     */
+    void setStreamCallbacks(GeminiStreamCallbacks callbacks)
+    {
+        stream_ = std::make_unique<GeminiStreamCallbacks>(std::move(callbacks));
     }
+    void pauseStream();
+    void resumeStream();
+    void abortStream();
 
 protected:
     void sendRequestInLoop();
     void onRecvMessage(const trantor::TcpConnectionPtr &connPtr,
                     trantor::MsgBuffer *msg);
     void haveResult(drogon::ReqResult result, const trantor::MsgBuffer* msg);
+    // Re-issues the request if the response is a redirect the context's
+    // policy follows. Returns false if the response should be delivered.
+    bool followRedirect();
 
     // User specifable values
     trantor::EventLoop* loop_;
@@ -87,32 +156,84 @@ protected:
     uint16_t port_;
     trantor::InetAddress peerAddress_;
     bool headerReceived_ = false;
+    // Bytes of the receive buffer already searched for the end of the header
+    std::size_t headerScanned_ = 0;
     int responseStatus_ = 0;
     std::string resoneseMeta_;
     trantor::TimerId timeoutTimerId_;
     std::vector<std::string> downloadMimes_;
+    // Views of downloadMimes_
+    std::unordered_set<std::string_view> downloadMimeSet_;
     trantor::TimerId transferTimerId_;
+    // When maxTransferDuration_ runs out. Set by the first request and
+    // inherited by redirect hops, so the limit covers the whole chain.
+    std::optional<std::chrono::steady_clock::time_point> transferDeadline_;
     bool callbackCalled_ = false;
     ServerTrust trust_;
     bool trustStarted_ = false;
+    std::shared_ptr<GeminiClientContext> context_;
+    // Keeps an in-flight request alive without any shared bookkeeping. Set
+    // by fire() and released by haveResult() on the client's loop.
+    std::shared_ptr<GeminiClient> self_;
+    std::unique_ptr<GeminiStreamCallbacks> stream_;
+    std::weak_ptr<trantor::TcpConnection> connection_;
+    bool aborted_ = false;
+    // Set when peerAddress_ was carried over from a redirect to the same host
+    bool addressKnown_ = false;
+    // URLs requested so far, starting with the original one. Empty until a
+    // redirect is followed.
+    std::vector<std::string> redirects_;
 };
 
 }
 
+/**
+ * @brief Send a request. Redirects are followed as the context's
+ *        RedirectPolicy allows; if any were, the response carries a
+ *        `gemini-redirects` header listing every URL requested, separated by
+ *        spaces, from `url` to the one that produced the response.
+ */
 void sendRequest(const std::string& url, const drogon::HttpReqCallback& callback, double timeout = 0
     , trantor::EventLoop* loop=drogon::app().getLoop(), intmax_t maxBodySize = -1, const std::vector<std::string>& mimes = {}
-    , double maxTransferDuration=0, ServerTrust trust = kNoVerification);
+    , double maxTransferDuration=0, ServerTrust trust = kNoVerification
+    , std::shared_ptr<GeminiClientContext> context = nullptr);
+
+/**
+ * @brief Send a request and receive the response incrementally. Only the
+ *        chunk being delivered is buffered, so memory use does not grow with
+ *        the size of the body. All callbacks run on `loop`.
+ */
+void sendStreamRequest(const std::string& url, GeminiStreamCallbacks callbacks, double timeout = 0
+    , trantor::EventLoop* loop=drogon::app().getLoop(), double maxTransferDuration=0, ServerTrust trust = kNoVerification
+    , std::shared_ptr<GeminiClientContext> context = nullptr);
 
 #ifdef __cpp_impl_coroutine
 namespace internal
 {
+inline std::string reqResultReason(drogon::ReqResult res)
+{
+    using drogon::ReqResult;
+    if (res == ReqResult::BadResponse)
+        return "BadResponse";
+    else if (res == ReqResult::NetworkFailure)
+        return "NetworkFailure";
+    else if (res == ReqResult::BadServerAddress)
+        return "BadServerAddress";
+    else if (res == ReqResult::Timeout)
+        return "Timeout";
+    else if(res == ReqResult::HandshakeError)
+        return "HandshakeError";
+    else if(res == ReqResult::InvalidCertificate)
+        return "InvalidCertificate";
+    return "";
+}
 
 struct [[nodiscard]] GeminiRespAwaiter
 {
     GeminiRespAwaiter(std::string url, trantor::EventLoop* loop, double timeout = 10, intmax_t maxBodySize = -1, const std::vector<std::string>& mimes = {}
-        , double maxTransferDuration=0, ServerTrust trust = kNoVerification)
+        , double maxTransferDuration=0, ServerTrust trust = kNoVerification, std::shared_ptr<GeminiClientContext> context = nullptr)
         : url_(url), loop_(loop), timeout_(timeout), maxBodySize_(maxBodySize), mimes_(mimes), maxTransferDuration_(maxTransferDuration),
-          trust_(std::move(trust))
+          trust_(std::move(trust)), context_(std::move(context))
     {
     }
 
@@ -138,24 +259,9 @@ struct [[nodiscard]] GeminiRespAwaiter
             if (res == ReqResult::Ok)
                 state->response = std::move(resp);
             else
-            {
-                std::string reason;
-                if (res == ReqResult::BadResponse)
-                    reason = "BadResponse";
-                else if (res == ReqResult::NetworkFailure)
-                    reason = "NetworkFailure";
-                else if (res == ReqResult::BadServerAddress)
-                    reason = "BadServerAddress";
-                else if (res == ReqResult::Timeout)
-                    reason = "Timeout";
-                else if(res == ReqResult::HandshakeError)
-                    reason = "HandshakeError";
-                else if(res == ReqResult::InvalidCertificate)
-                    reason = "InvalidCertificate";
-                state->exception = std::make_exception_ptr(std::runtime_error(reason));
-            }
+                state->exception = std::make_exception_ptr(std::runtime_error(reqResultReason(res)));
             state->handle.resume();
-        }, timeout_, loop_, maxBodySize_, mimes_, maxTransferDuration_, std::move(trust_));
+        }, timeout_, loop_, maxBodySize_, mimes_, maxTransferDuration_, std::move(trust_), std::move(context_));
     }
 
     drogon::HttpResponsePtr await_resume()
@@ -180,17 +286,86 @@ private:
     std::vector<std::string> mimes_;
     double maxTransferDuration_;
     ServerTrust trust_;
+    std::shared_ptr<GeminiClientContext> context_;
     std::shared_ptr<State> state_ = std::make_shared<State>();
 };
 }
 
 inline internal::GeminiRespAwaiter sendRequestCoro(const std::string& url, double timeout = 10
     , trantor::EventLoop* loop=drogon::app().getLoop(), intmax_t maxBodySize = -1, const std::vector<std::string>& mimes = {}
-    , double maxTransferDuration = 0, ServerTrust trust = kNoVerification)
+    , double maxTransferDuration = 0, ServerTrust trust = kNoVerification
+    , std::shared_ptr<GeminiClientContext> context = nullptr)
 {
-    return internal::GeminiRespAwaiter(url, loop, timeout, maxBodySize, mimes, maxTransferDuration, std::move(trust));
+    return internal::GeminiRespAwaiter(url, loop, timeout, maxBodySize, mimes, maxTransferDuration, std::move(trust),
+                                       std::move(context));
 }
 
+namespace internal
+{
+// Shared between the stream callbacks, which run on the client's loop, and
+// the reading coroutine, which may run anywhere.
+struct ChunkReaderState
+{
+    std::mutex mutex;
+    bool headerReceived = false;
+    int status = 0;
+    std::string meta;
+    std::deque<std::string> chunks;
+    std::size_t queuedBytes = 0;
+    bool paused = false;
+    bool finished = false;
+    // Set when the reader is destroyed before the request finished
+    bool abandoned = false;
+    drogon::ReqResult result = drogon::ReqResult::Ok;
+    std::optional<GeminiStreamHandle> handle;
+    std::coroutine_handle<> waiter;
+};
+
+struct [[nodiscard]] StreamHeaderAwaiter
+{
+    std::shared_ptr<ChunkReaderState> state;
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> handle);
+    std::pair<int, std::string> await_resume();
+};
+
+struct [[nodiscard]] StreamChunkAwaiter
+{
+    std::shared_ptr<ChunkReaderState> state;
+    bool await_ready();
+    bool await_suspend(std::coroutine_handle<> handle);
+    std::optional<std::string> await_resume();
+};
+}
+
+/**
+ * @brief Coroutine view of a streaming request. Await header() first, then
+ *        next() until it yields std::nullopt. Failures are thrown from either
+ *        as std::runtime_error, like sendRequestCoro(). Reading pauses the
+ *        connection while unread chunks pile up, and destroying the reader
+ *        aborts a request still in progress.
+ */
+class GeminiChunkReader
+{
+public:
+    explicit GeminiChunkReader(std::shared_ptr<internal::ChunkReaderState> state) : state_(std::move(state)) {}
+    GeminiChunkReader(GeminiChunkReader&&) = default;
+    GeminiChunkReader& operator=(GeminiChunkReader&&) = default;
+    ~GeminiChunkReader();
+
+    // Yields the status and meta of the response.
+    internal::StreamHeaderAwaiter header() { return {state_}; }
+    // Yields the next body chunk, or std::nullopt once the body is complete.
+    internal::StreamChunkAwaiter next() { return {state_}; }
+
+private:
+    std::shared_ptr<internal::ChunkReaderState> state_;
+};
+
+GeminiChunkReader sendStreamRequestCoro(const std::string& url, double timeout = 10
+    , trantor::EventLoop* loop=drogon::app().getLoop(), double maxTransferDuration = 0
+    , ServerTrust trust = kNoVerification, std::shared_ptr<GeminiClientContext> context = nullptr);
+
 #endif
 
 
@@ -0,0 +1,67 @@
+#include <dremini/GeminiClientContext.hpp>
+#include <trantor/net/Resolver.h>
+
+namespace dremini
+{
+GeminiClientContext::GeminiClientContext(DnsCacheOptions dnsOptions)
+    : dnsCache_(std::move(dnsOptions), [this](const std::string& host, DnsCache::Callback done) {
+          // Misses are resolved on the loop that asked first
+          resolverFor(trantor::EventLoop::getEventLoopOfCurrentThread())->resolve(host, std::move(done));
+      })
+{
+    policy_.setValidate(false)
+        .setAllowBrokenChain(true)
+        .setUseSystemCertStore(false)
+        .setUseOldTLS(false);
+}
+
+std::shared_ptr<trantor::TLSPolicy> GeminiClientContext::tlsPolicy(const std::string& host) const
+{
+    auto policy = std::make_shared<trantor::TLSPolicy>(policy_);
+    policy->setHostname(host);
+    return policy;
+}
+
+void GeminiClientContext::resolve(trantor::EventLoop* loop,
+                                  const std::string& host,
+                                  std::function<void(const trantor::InetAddress&)> callback)
+{
+    loop->assertInLoopThread();
+    // Coalesced lookups complete on whichever loop started the query
+    dnsCache_.resolve(host, [loop, callback = std::move(callback)](const trantor::InetAddress& address) {
+        loop->runInLoop([callback, address]() { callback(address); });
+    });
+}
+
+std::shared_ptr<trantor::Resolver> GeminiClientContext::resolverFor(trantor::EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(resolvers_->mutex);
+    auto& resolver = resolvers_->byLoop[loop];
+    if(!resolver)
+    {
+        resolver = trantor::Resolver::newResolver(loop, static_cast<int>(dnsCache_.options().resolverTimeout));
+        loop->runOnQuit([weakResolvers = std::weak_ptr<Resolvers>(resolvers_), loop]() {
+            const auto resolvers = weakResolvers.lock();
+            if(!resolvers)
+                return;
+            std::shared_ptr<trantor::Resolver> released;
+            std::lock_guard<std::mutex> lock(resolvers->mutex);
+            const auto it = resolvers->byLoop.find(loop);
+            if(it == resolvers->byLoop.end())
+                return;
+            // Destroyed after the lock is released, still on the quitting loop
+            released = std::move(it->second);
+            resolvers->byLoop.erase(it);
+        });
+    }
+    return resolver;
+}
+
+const std::shared_ptr<GeminiClientContext>& defaultClientContext()
+{
+    // Never destroyed: its resolvers belong to loops that may be gone by the
+    // time static objects are torn down.
+    static const auto* context = new std::shared_ptr<GeminiClientContext>(std::make_shared<GeminiClientContext>());
+    return *context;
+}
+}  // namespace dremini
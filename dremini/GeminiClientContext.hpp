@@ -0,0 +1,79 @@
+#pragma once
+
+#include <dremini/DnsCache.hpp>
+#include <trantor/net/EventLoop.h>
+#include <trantor/net/InetAddress.h>
+#include <trantor/net/TLSPolicy.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace trantor
+{
+class Resolver;
+}
+
+namespace dremini
+{
+// Which 3x redirects the requests of a context follow. Only gemini:// targets
+// can be followed; a redirect to any other scheme is returned as is, as are
+// redirects beyond the policy. The default follows none. A request's
+// maxTransferDuration covers the whole chain, not each hop.
+struct RedirectPolicy
+{
+    std::size_t maxHops = 0;
+    // Only follow redirects to the same host and port.
+    bool sameHostOnly = false;
+};
+
+// State shared by the requests of a client, so each request only sets up its
+// socket and TLS handshake. Thread safe; one context can serve every loop.
+class GeminiClientContext
+{
+public:
+    explicit GeminiClientContext(DnsCacheOptions dnsOptions = {});
+
+    // TLS policy for a connection to `host`. Certificates are checked by the
+    // request's ServerTrust rather than OpenSSL, so the system certificate
+    // store, the most expensive part of setting up a TLS context, is never
+    // loaded.
+    std::shared_ptr<trantor::TLSPolicy> tlsPolicy(const std::string& host) const;
+
+    // Resolves `host` through the context's DNS cache, querying the resolver
+    // of `loop` on a miss. Must be called on `loop`, which also runs
+    // `callback`. Unresolvable hosts yield a default-constructed address,
+    // whose ipNetEndian() is 0.
+    void resolve(trantor::EventLoop* loop,
+                 const std::string& host,
+                 std::function<void(const trantor::InetAddress&)> callback);
+    const DnsCache& dnsCache() const { return dnsCache_; }
+
+    // Set before the context is used by any request.
+    void setRedirectPolicy(const RedirectPolicy& policy) { redirectPolicy_ = policy; }
+    const RedirectPolicy& redirectPolicy() const { return redirectPolicy_; }
+
+private:
+    std::shared_ptr<trantor::Resolver> resolverFor(trantor::EventLoop* loop);
+
+    // A loop's resolver is dropped when the loop quits, so a later loop at
+    // the same address never inherits it. The quit callbacks hold only a
+    // weak reference, as the context may be gone by then.
+    struct Resolvers
+    {
+        std::mutex mutex;
+        std::unordered_map<trantor::EventLoop*, std::shared_ptr<trantor::Resolver>> byLoop;
+    };
+
+    trantor::TLSPolicy policy_;
+    std::shared_ptr<Resolvers> resolvers_ = std::make_shared<Resolvers>();
+    DnsCache dnsCache_;
+    RedirectPolicy redirectPolicy_;
+};
+
+// Used by requests that are not given a context.
+const std::shared_ptr<GeminiClientContext>& defaultClientContext();
+}  // namespace dremini
@@ -1,161 +1,266 @@
 #include "GeminiParser.hpp"
+#include "NewlineScanner.hpp"
 #include <algorithm>
-#include <iostream>
-#include <sstream>
+#include <array>
+#include <cctype>
+#include <stdexcept>
 
 static bool startsWith(const std::string_view sv, const std::string_view target)
 {
-    if(sv.size() < target.size())
-        return false;
-#if 0
-    auto start_idx = sv.find_first_not_of(' ');
-    if(start_idx+target.size() > sv.size())
-        return false;
-
-    for(size_t i=0;i<target.size();i++) {
-        if(sv[start_idx+i] != target[i])
-            return false;
-    }
-    return true;
-#else
     return sv.substr(0, target.size()) == target;
-#endif
 }
 
 namespace dremini
 {
-static std::string_view ltrim(std::string_view s)
+static bool isSpace(char c)
 {
-    s.remove_prefix(std::distance(s.cbegin(), std::find_if(s.cbegin(), s.cend(),
-         [](int c) {return !std::isspace(c);})));
+    return std::isspace(static_cast<unsigned char>(c));
+}
 
+static std::string_view ltrim(std::string_view s)
+{
+    s.remove_prefix(std::distance(s.cbegin(), std::find_if_not(s.cbegin(), s.cend(), isSpace)));
     return s;
 }
 
 static std::string_view rtrim(std::string_view s)
 {
-    s.remove_suffix(std::distance(s.crbegin(), std::find_if(s.crbegin(), s.crend(),
-        [](int c) {return !std::isspace(c);})));
-
+    s.remove_suffix(std::distance(s.crbegin(), std::find_if_not(s.crbegin(), s.crend(), isSpace)));
     return s;
 }
 
-static std::string trim(std::string s)
+static std::string_view trim(std::string_view s)
 {
-    return std::string(ltrim(rtrim(s)));
+    return ltrim(rtrim(s));
 }
 
-std::vector<GeminiASTNode> parseGemini(const std::string_view str)
+static constexpr std::array<std::string_view, 8> node_type_names = {
+    "text", "link", "heading1", "heading2", "heading3", "list", "quote", "preformatted_text"};
+
+std::string_view nodeTypeName(GeminiNodeType type)
 {
-    std::vector<GeminiASTNode> nodes;
-    size_t last_pos = 0;
-    bool in_preformatted_text = false;
-    size_t preformatted_text_start = 0;
-    std::string preformatted_text_meta = "";
-    for(size_t i=0;i<str.size()+1;i++) {
-        if((i == str.size() && i != 0 && str[i-1] != '\n')|| (i < str.size() && str[i] == '\n')) {
-            if(in_preformatted_text == false) {
-                std::string_view line(str.data()+last_pos, i-last_pos);
-                auto crlf = line.find_last_not_of("\r\n");
-                if(crlf != std::string_view::npos)
-                    line = std::string_view(line.data(), crlf+1);
-                else
-                    line = std::string_view(line.data(), 0);
-
-                GeminiASTNode node;
-                node.orig_text = line;
-                if(startsWith(line, "=>")) {
-                    std::string_view sv = line.substr(2);
-                    std::string_view link;
-                    std::string_view text;
-                    auto link_start = sv.find_first_not_of(" \t");
-                    if(link_start != std::string_view::npos) {
-                        sv = sv.substr(link_start);
-                        auto link_end = sv.find_first_of(" \t");
-                        link = sv.substr(0, link_end);
-                        if(link_end != std::string_view::npos) {
-                            sv = sv.substr(link_end);
-                            auto text_start = sv.find_first_not_of(" \t");
-                            if(text_start != std::string_view::npos) {
-                                sv = sv.substr(text_start);
-                                auto text_end = sv.find_last_not_of(" \t");
-                                text = sv.substr(0, text_end == std::string_view::npos? text_end : text_end+1);
-                            }
-                        }
-                    }
-                    node.text = text;
-                    node.meta = link;
-                    node.type = "link";
-                }
-                else if(startsWith(line, "###")) {
-                    node.text = trim(std::string(line.substr(3)));
-                    node.type = "heading3";
-                }
-                else if(startsWith(line, "##")) {
-                    node.text = trim(std::string(line.substr(2)));
-                    node.type = "heading2";
-                }
-                else if(startsWith(line, "#")) {
-                    node.text = trim(std::string(line.substr(1)));
-                    node.type = "heading1";
-                }
-                else if(startsWith(line, "* ")) {
-                    node.text = ltrim(line.substr(1));
-                    node.type = "list";
-                }
-                else if(startsWith(line, ">")) {
-                    node.text = line.substr(1);
-                    node.type = "quote";
-                }
-                else if(startsWith(line, "```")) {
-                    preformatted_text_meta = line.substr(3);
-                    in_preformatted_text = true;
-                    preformatted_text_start = last_pos;
-                    last_pos = i+1;
-                    continue;
-                }
-                else {
-                    node.text = line;
-                    node.type = "text";
-                }
-                last_pos = i+1;
+    return node_type_names[static_cast<std::size_t>(type)];
+}
 
-                nodes.emplace_back(std::move(node));
-            }
-            else {
-                std::string_view line(str.data()+last_pos, i-last_pos);
-                auto crlf = line.find_last_not_of("\r\n");
-                if(crlf != std::string_view::npos)
-                    line = std::string_view(line.data(), crlf+1);
-                last_pos = i+1;
-
-                if(startsWith(line, "```")) {
-                    std::string_view preformatted_text(str.data()+preformatted_text_start, i-preformatted_text_start);
-                    GeminiASTNode node;
-                    node.orig_text = preformatted_text;
-
-                    std::stringstream ss;
-                    std::string line;
-                    std::string content;
-                    ss << preformatted_text;
-                    std::getline(ss, line);
-                    if(line.size() > 3)
-                        node.meta = line.substr(4);
-
-                    while(std::getline(ss, line)) {
-                        if(line.find("```") != 0)
-                            content += line + "\n";
+std::optional<GeminiNodeType> nodeTypeFromName(std::string_view name)
+{
+    const auto it = std::find(node_type_names.begin(), node_type_names.end(), name);
+    if(it == node_type_names.end())
+        return std::nullopt;
+    return static_cast<GeminiNodeType>(it - node_type_names.begin());
+}
+
+// Classifies a line outside of preformatted blocks by its first byte.
+// `line` has no line terminator and does not start a preformatted block.
+static GeminiNode parseLine(std::string_view line)
+{
+    GeminiNode node;
+    node.orig_text = line;
+    node.text = line;
+    const char first = line.empty() ? '\0' : line[0];
+    switch(first) {
+    case '=':
+        if(startsWith(line, "=>")) {
+            node.text = {};
+            std::string_view sv = line.substr(2);
+            auto link_start = sv.find_first_not_of(" \t");
+            if(link_start != std::string_view::npos) {
+                sv = sv.substr(link_start);
+                auto link_end = sv.find_first_of(" \t");
+                node.meta = sv.substr(0, link_end);
+                if(link_end != std::string_view::npos) {
+                    sv = sv.substr(link_end);
+                    auto text_start = sv.find_first_not_of(" \t");
+                    if(text_start != std::string_view::npos) {
+                        sv = sv.substr(text_start);
+                        auto text_end = sv.find_last_not_of(" \t");
+                        node.text = sv.substr(0, text_end == std::string_view::npos? text_end : text_end+1);
                     }
-                    node.text = content;
-                    node.meta = preformatted_text_meta;
-                    node.type = "preformatted_text";
-                    in_preformatted_text = false;
-                    nodes.emplace_back(std::move(node));
                 }
             }
+            node.type = GeminiNodeType::Link;
+        }
+        break;
+    case '#': {
+        const auto level = std::min({line.find_first_not_of('#'), line.size(), size_t{3}});
+        node.text = trim(line.substr(level));
+        node.type = level == 1 ? GeminiNodeType::Heading1 :
+                    level == 2 ? GeminiNodeType::Heading2 : GeminiNodeType::Heading3;
+        break;
+    }
+    case '*':
+        if(startsWith(line, "* ")) {
+            node.text = ltrim(line.substr(1));
+            node.type = GeminiNodeType::List;
         }
+        break;
+    case '>':
+        node.text = line.substr(1);
+        node.type = GeminiNodeType::Quote;
+        break;
+    default:
+        break;
     }
+    return node;
+}
+
+// Handles the line str[pos, line_end), the next of which starts at `next`.
+// Returns true when that completes a node, which is stored in `node`.
+static bool parseLineAt(std::string_view str, size_t pos, size_t line_end, size_t next,
+                        internal::PreformattedBlock& block, GeminiNode& node)
+{
+    std::string_view line = str.substr(pos, line_end-pos);
+    line = line.substr(0, line.find_last_not_of('\r')+1);
+    const bool fence = line.size() >= 3 && line[0] == '`' && line[1] == '`' && line[2] == '`';
+
+    if(block.open == false) {
+        if(fence) {
+            block = internal::PreformattedBlock{true, pos, next, pos+3, line.size()-3};
+            return false;
+        }
+        node = parseLine(line);
+        return true;
+    }
+    if(!fence)
+        return false;
+    // The content is every line in between, each with its newline, which is
+    // exactly the source between the two ``` lines.
+    node.orig_text = str.substr(block.start, line_end-block.start);
+    node.text = str.substr(block.body_start, pos-block.body_start);
+    node.meta = str.substr(block.meta_start, block.meta_size);
+    node.type = GeminiNodeType::PreformattedText;
+    block.open = false;
+    return true;
+}
+
+std::vector<GeminiNode> parseGeminiNodes(const std::string_view str)
+{
+    std::vector<GeminiNode> nodes;
+    // A low guess at the line count, to skip the first reallocations
+    nodes.reserve(str.size() / 64);
+    internal::PreformattedBlock block;
+    GeminiNode node;
+    // Line breaks are found a batch at a time and the lines parsed straight
+    // away, while they are still in cache
+    internal::NewlineBatch newlines;
+    size_t pos = 0;
+    for(size_t scanned = 0; scanned < str.size();) {
+        const size_t base = scanned;
+        scanned += internal::findNewlines(str.substr(base), newlines);
+        for(size_t i = 0; i < newlines.size; i++) {
+            const size_t line_end = base + newlines.offsets[i];
+            if(parseLineAt(str, pos, line_end, line_end+1, block, node))
+                nodes.push_back(node);
+            pos = line_end+1;
+        }
+    }
+    if(pos < str.size() && parseLineAt(str, pos, str.size(), str.size(), block, node))
+        nodes.push_back(node);
     return nodes;
 }
 
+GeminiStreamParser::GeminiStreamParser(NodeCallback callback, std::size_t maxBufferSize)
+    : callback_(std::move(callback))
+    , maxBufferSize_(maxBufferSize)
+{
+}
+
+void GeminiStreamParser::feed(std::string_view chunk)
+{
+    const bool buffered = !buffer_.empty();
+    // What is buffered is at most one unfinished line, so only the new bytes
+    // can hold line breaks.
+    const size_t scan_from = buffer_.size();
+    if(buffered)
+        buffer_.append(chunk);
+    const std::string_view text = buffered ? std::string_view(buffer_) : chunk;
+
+    GeminiNode node;
+    internal::NewlineBatch newlines;
+    try {
+        for(size_t scanned = scan_from; scanned < text.size();) {
+            const size_t base = scanned;
+            scanned += internal::findNewlines(text.substr(base), newlines);
+            for(size_t i = 0; i < newlines.size; i++) {
+                const size_t line_end = base + newlines.offsets[i];
+                if(parseLineAt(text, lineStart_, line_end, line_end+1, block_, node))
+                    callback_(node);
+                lineStart_ = line_end+1;
+            }
+        }
+    }
+    catch(...) {
+        // lineStart_ may point past the end of buffer_ or into a chunk that
+        // is gone, so the document is abandoned, as when the buffer is full
+        reset();
+        throw;
+    }
+
+    // Keep the unfinished line, and the open block it belongs to
+    const size_t keep = block_.open ? block_.start : lineStart_;
+    if(text.size() - keep > maxBufferSize_) {
+        reset();
+        throw std::runtime_error("Gemtext line or preformatted block is larger than the parser's buffer");
+    }
+    if(buffered)
+        buffer_.erase(0, keep);
+    else
+        buffer_.assign(chunk.substr(keep));
+    lineStart_ -= keep;
+    if(block_.open) {
+        block_.start -= keep;
+        block_.body_start -= keep;
+        block_.meta_start -= keep;
+    }
+}
+
+void GeminiStreamParser::finish()
+{
+    // Reset first so the parser can be reused even if the callback throws
+    const std::string text = std::move(buffer_);
+    const size_t pos = lineStart_;
+    auto block = block_;
+    reset();
+
+    GeminiNode node;
+    if(pos < text.size() && parseLineAt(text, pos, text.size(), text.size(), block, node))
+        callback_(node);
+}
+
+void GeminiStreamParser::reset()
+{
+    buffer_.clear();
+    lineStart_ = 0;
+    block_ = {};
+}
+
+GeminiDocument::GeminiDocument(std::string source)
+    : source_(std::make_unique<const std::string>(std::move(source)))
+    , nodes_(parseGeminiNodes(*source_))
+{
+}
+
+std::vector<GeminiASTNode> parseGemini(const std::string_view str)
+{
+    const auto nodes = parseGeminiNodes(str);
+    std::vector<GeminiASTNode> result;
+    result.reserve(nodes.size());
+    for(const auto& node : nodes) {
+        result.push_back(GeminiASTNode{std::string(node.orig_text), std::string(node.text),
+                                       std::string(nodeTypeName(node.type)), std::string(node.meta)});
+    }
+    return result;
+}
+
+std::vector<GeminiNode> viewNodes(const std::vector<GeminiASTNode>& nodes)
+{
+    std::vector<GeminiNode> result;
+    result.reserve(nodes.size());
+    for(const auto& node : nodes) {
+        result.push_back(GeminiNode{nodeTypeFromName(node.type).value_or(GeminiNodeType::Text),
+                                    node.orig_text, node.text, node.meta});
+    }
+    return result;
+}
+
 }
@@ -1,11 +1,46 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <string>
 
 namespace dremini
 {
+enum class GeminiNodeType : std::uint8_t
+{
+    Text,
+    Link,
+    Heading1,
+    Heading2,
+    Heading3,
+    List,
+    Quote,
+    PreformattedText
+};
+
+/**
+ * @brief The name GeminiASTNode::type uses for `type`, e.g. "heading2" or
+ *        "preformatted_text".
+ */
+std::string_view nodeTypeName(GeminiNodeType type);
+std::optional<GeminiNodeType> nodeTypeFromName(std::string_view name);
+
+/**
+ * @brief A gemtext line, or preformatted block, whose text fields are views
+ *        into the parsed source.
+ */
+struct GeminiNode
+{
+    GeminiNodeType type = GeminiNodeType::Text;
+    std::string_view orig_text;
+    std::string_view text;
+    std::string_view meta;
+};
+
 struct GeminiASTNode
 {
     std::string orig_text;
@@ -14,5 +49,96 @@ struct GeminiASTNode
     std::string meta;
 };
 
+/**
+ * @brief Parse gemtext without copying it. The nodes point into `source`,
+ *        which must outlive them.
+ */
+std::vector<GeminiNode> parseGeminiNodes(std::string_view source);
+
+/**
+ * @brief Parsed gemtext that owns its source, so its nodes stay valid for as
+ *        long as the document, including across moves.
+ */
+class GeminiDocument
+{
+public:
+    explicit GeminiDocument(std::string source);
+
+    std::string_view source() const { return *source_; }
+    const std::vector<GeminiNode>& nodes() const { return nodes_; }
+    std::vector<GeminiNode>::const_iterator begin() const { return nodes_.begin(); }
+    std::vector<GeminiNode>::const_iterator end() const { return nodes_.end(); }
+    std::size_t size() const { return nodes_.size(); }
+    const GeminiNode& operator[](std::size_t index) const { return nodes_[index]; }
+
+private:
+    // On the heap so moving the document does not move the text
+    std::unique_ptr<const std::string> source_;
+    std::vector<GeminiNode> nodes_;
+};
+
+namespace internal
+{
+// A preformatted block that has been opened but not yet closed, as offsets
+// into the text being parsed.
+struct PreformattedBlock
+{
+    bool open = false;
+    // The opening ``` line, and the line after it
+    std::size_t start = 0;
+    std::size_t body_start = 0;
+    std::size_t meta_start = 0;
+    std::size_t meta_size = 0;
+};
+}  // namespace internal
+
+/**
+ * @brief Parse gemtext as it arrives, in chunks split anywhere. The nodes
+ *        passed to the callback are those parseGeminiNodes() would return for
+ *        the whole text, in order, but their views are only valid during the
+ *        call.
+ *
+ * Only the unfinished line, or the open preformatted block, is buffered.
+ * feed() throws std::runtime_error, and drops what was buffered, when that
+ * grows past `maxBufferSize` bytes. An exception from the callback also
+ * drops what was buffered before it propagates, so the parser can be fed a
+ * new document.
+ */
+class GeminiStreamParser
+{
+public:
+    using NodeCallback = std::function<void(const GeminiNode& node)>;
+
+    explicit GeminiStreamParser(NodeCallback callback, std::size_t maxBufferSize = 0x100000);
+
+    void feed(std::string_view chunk);
+    /**
+     * @brief Parse the last line if it has no line break. An unterminated
+     *        preformatted block is dropped, like parseGeminiNodes() does.
+     *        The parser can then be fed a new document.
+     */
+    void finish();
+    std::size_t bufferedBytes() const { return buffer_.size(); }
+
+private:
+    void reset();
+
+    NodeCallback callback_;
+    std::size_t maxBufferSize_;
+    std::string buffer_;
+    // Where the first line not parsed yet starts in buffer_
+    std::size_t lineStart_ = 0;
+    internal::PreformattedBlock block_;
+};
+
+/**
+ * @brief Parse gemtext into nodes owning copies of their text. Prefer
+ *        parseGeminiNodes() or GeminiDocument, which do not copy.
+ */
 std::vector<GeminiASTNode> parseGemini(const std::string_view sv);
+
+/**
+ * @brief View `nodes` as GeminiNodes. Unknown types are treated as text.
+ */
+std::vector<GeminiNode> viewNodes(const std::vector<GeminiASTNode>& nodes);
 }
@@ -7,9 +7,9 @@
 #include <drogon/HttpViewData.h>
 
 #include <numeric>
-#include <optional>
 #include <stack>
 #include <string_view>
+#include <vector>
 
 using namespace drogon;
 using namespace dremini;
@@ -22,8 +22,10 @@ struct ParserState
     bool in_italic = false;
     bool in_strong = false;
     bool in_strike = false;
-    std::stack<std::string> styles;
-    std::stack<char> style_symbols;
+    // Vector backed, as a deque allocates even while empty and states are
+    // copied for every backtracking point
+    std::stack<std::string_view, std::vector<std::string_view>> styles;
+    std::stack<char, std::vector<char>> style_symbols;
 };
 
 static std::string renderPlainText(const std::string_view input)
@@ -194,9 +196,40 @@ static std::string renderPlainText(const std::string_view input)
     throw std::runtime_error("Parser ended in an invalid state. This is a bug.");
 }
 
-static std::string htmlEscape(const std::string_view input)
+// Appends `input` to `out` with the entities HttpViewData::htmlTranslate()
+// uses, without a temporary string.
+static void appendEscaped(std::string& out, const std::string_view input)
 {
-    return HttpViewData::htmlTranslate(std::string{input});
+    size_t pos = 0;
+    while(pos < input.size()) {
+        const auto n = input.find_first_of("\"&<>", pos);
+        if(n == std::string_view::npos) {
+            out.append(input.substr(pos));
+            return;
+        }
+        out.append(input.substr(pos, n-pos));
+        switch(input[n]) {
+        case '"': out += "&quot;"; break;
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        default: out += "&gt;"; break;
+        }
+        pos = n+1;
+    }
+}
+
+template <typename... Parts>
+static void emit(HtmlSink& sink, const Parts&... parts)
+{
+    (sink.append(std::string_view(parts)), ...);
+}
+
+static void emitPlainText(HtmlSink& sink, const std::string_view input)
+{
+    if(input.find_first_of("*_`~") == std::string_view::npos)
+        sink.append(input);
+    else
+        sink.append(renderPlainText(input));
 }
 
 static bool hasForbiddenUrlCharacter(const std::string_view value)
@@ -217,26 +250,39 @@ static bool isAllowedUrlScheme(const std::string_view scheme)
 
 // Gemtext link targets are data, not HTML. Do not turn active browser URL
 // schemes such as javascript: or data: into attributes in the HTTP renderer.
-static std::optional<std::string> htmlLinkTarget(std::string_view value)
+static bool isAllowedLinkTarget(std::string_view value)
 {
-    if (value.empty() || value.substr(0, 2) == "//" || hasForbiddenUrlCharacter(value)) return std::nullopt;
+    if (value.empty() || value.substr(0, 2) == "//" || hasForbiddenUrlCharacter(value)) return false;
     const auto colon = value.find(':');
     if (colon != std::string_view::npos)
     {
-        if (colon == 0) return std::nullopt;
+        if (colon == 0) return false;
         for (std::size_t index = 0; index < colon; ++index)
         {
             const auto character = static_cast<unsigned char>(value[index]);
             if (!(std::isalnum(character) || character == '+' || character == '-' || character == '.'))
-                return std::nullopt;
+                return false;
         }
         std::string scheme{value.substr(0, colon)};
         std::transform(scheme.begin(), scheme.end(), scheme.begin(), [](const unsigned char character) {
             return static_cast<char>(std::tolower(character));
         });
-        if (!isAllowedUrlScheme(scheme)) return std::nullopt;
+        if (!isAllowedUrlScheme(scheme)) return false;
     }
-    return htmlEscape(value);
+    return true;
+}
+
+// Whether any of `exts`, which all start with '.', occurs anywhere in `url`.
+// Only the dots are compared against, rather than searching for every one.
+template <size_t N>
+static bool containsExtension(const std::string_view url, const std::array<std::string_view, N>& exts)
+{
+    for(auto dot = url.find('.'); dot != std::string_view::npos; dot = url.find('.', dot+1)) {
+        const auto rest = url.substr(dot);
+        if(std::any_of(exts.begin(), exts.end(), [rest](const std::string_view ext) { return rest.substr(0, ext.size()) == ext; }))
+            return true;
+    }
+    return false;
 }
 
 static bool isSafeYoutubeId(const std::string_view value)
@@ -299,58 +345,100 @@ static std::string_view trim(std::string_view str, std::string_view ignore_chars
     return start == std::string_view::npos ? "" : str.substr(start, end - start + 1);
 }
 
+// Calls `f` with each field std::getline() would extract from `str`, without
+// the stream: there is no empty field after a trailing delimiter. Stops early
+// once `f` returns false.
+template <typename Function>
+static void forEachField(std::string_view str, char delim, Function&& f)
+{
+    size_t pos = 0;
+    while(pos < str.size()) {
+        auto end = str.find(delim, pos);
+        if(end == std::string_view::npos)
+            end = str.size();
+        if(!f(str.substr(pos, end-pos)))
+            return;
+        pos = end+1;
+    }
+}
+
 std::pair<std::string, std::string> dremini::render2Html(const std::string_view gmi_source, bool extended_mode)
 {
-    auto nodes = parseGemini(gmi_source);
-    return render2Html(nodes, extended_mode);
+    return render2Html(parseGeminiNodes(gmi_source), extended_mode);
 }
 
 std::pair<std::string, std::string> dremini::render2Html(const std::vector<GeminiASTNode>& nodes, bool extended_mode)
+{
+    return render2Html(viewNodes(nodes), extended_mode);
+}
+
+std::pair<std::string, std::string> dremini::render2Html(const std::vector<GeminiNode>& nodes, bool extended_mode)
 {
     std::string res;
-    std::string title;
+    size_t total_size = std::accumulate(nodes.begin(), nodes.end(), size_t{0}, [](size_t n, auto& node) -> size_t {return n+node.text.size();});
+    res.reserve(total_size);
+    StringHtmlSink sink(res);
+    auto title = render2Html(nodes, sink, extended_mode);
+    return {std::move(res), std::move(title)};
+}
+
+std::string dremini::render2Html(const std::string_view gmi_source, HtmlSink& sink, bool extended_mode)
+{
+    return render2Html(parseGeminiNodes(gmi_source), sink, extended_mode);
+}
+
+std::string dremini::render2Html(const std::vector<GeminiNode>& nodes, HtmlSink& sink, bool extended_mode)
+{
+    std::string_view title;
     bool last_is_list = false;
     bool last_is_backquote = false;
     std::set<std::string> paragraph_names;
-    size_t total_size = std::accumulate(nodes.begin(), nodes.end(), size_t{0}, [](size_t n, auto& node) -> size_t {return n+node.text.size();});
-    res.reserve(total_size);
+    // Scratch space reused by every node, so escaping stops allocating once
+    // it has grown to fit the longest line
+    std::string text;
+    std::string escaped;
+    std::string rewritten_meta;
 
     for(const auto& node : nodes) {
-        std::string text = htmlEscape(node.text);
+        text.clear();
+        appendEscaped(text, node.text);
 
-        if(node.type == "heading1" && title.empty())
+        if(node.type == GeminiNodeType::Heading1 && title.empty())
             title = node.text;
 
-        if(node.type != "list" && last_is_list == true)
-            res += "</ul>\n";
-        if(node.type != "quote" && last_is_backquote == true)
-            res += "</blockquote>\n";
+        if(node.type != GeminiNodeType::List && last_is_list == true)
+            sink.append("</ul>\n");
+        if(node.type != GeminiNodeType::Quote && last_is_backquote == true)
+            sink.append("</blockquote>\n");
 
-        if(node.type == "text") {
+        if(node.type == GeminiNodeType::Text) {
             if(extended_mode) {
                 // all "-" or "=" and is at least 3 chars => horizontal line
                 if(!text.empty() && (text[0] == '-' || text[0] == '=')
                     && text.size() >= 3 && isSingleCharRepeat(text)) {
 
-                    res += "<hr>\n";
+                    sink.append("<hr>\n");
                     continue;
                 }
                 // TODO: Do we need to translate text in extended mode?
-                res += "<p>"+renderPlainText(text)+"</p>\n";
+                sink.append("<p>");
+                emitPlainText(sink, text);
+                sink.append("</p>\n");
             }
             else
-                res += "<p>"+text+"</p>\n";
+                emit(sink, "<p>", text, "</p>\n");
         }
-        else if(node.type == "heading1" || node.type == "heading2" || node.type == "heading3")
+        else if(node.type == GeminiNodeType::Heading1 || node.type == GeminiNodeType::Heading2
+            || node.type == GeminiNodeType::Heading3)
         {
-            std::string tag = "h1";
-            if(node.type == "heading2")
+            std::string_view tag = "h1";
+            if(node.type == GeminiNodeType::Heading2)
                 tag = "h2";
-            else if(node.type == "heading3")
+            else if(node.type == GeminiNodeType::Heading3)
                 tag = "h3";
 
             if(!extended_mode || tag == "h1")
-                res += "<"+tag+">"+text+"</"+tag+">\n";
+                emit(sink, "<", tag, ">", text, "</", tag, ">\n");
             else {
                 std::string id = urlFriendly(text);
                 if(paragraph_names.find(id) != paragraph_names.end()) {
@@ -359,111 +447,109 @@ std::pair<std::string, std::string> dremini::render2Html(const std::vector<Gemin
                         i++;
                     id += "-"+std::to_string(i);
                 }
-                paragraph_names.insert(id);
-                const auto escaped_id = htmlEscape(id);
-                res += "<"+tag+" id=\""+escaped_id+"\"><a href=\"#"+escaped_id+"\">"+text+"</a></"+tag+">\n";
+                escaped.clear();
+                appendEscaped(escaped, id);
+                paragraph_names.insert(std::move(id));
+                emit(sink, "<", tag, " id=\"", escaped, "\"><a href=\"#", escaped, "\">", text, "</a></", tag, ">\n");
             }
             continue;
         }
-        else if(node.type == "link")
+        else if(node.type == GeminiNodeType::Link)
         {
             if(text.empty())
-                text = htmlEscape(node.meta);
-            std::string meta = node.meta;
+                appendEscaped(text, node.meta);
+            std::string_view meta = node.meta;
             // Quick and dirty parameter hack
             auto n = meta.find('?');
-            if(n != std::string::npos && meta.find("gemini://") != 0 && meta.find("http") != 0) {
-                std::string url = meta.substr(0, n);
-                std::string param = meta.substr(n+1);
-                meta = url + "?query=" + param;
+            if(n != std::string_view::npos && meta.find("gemini://") != 0 && meta.find("http") != 0) {
+                rewritten_meta.clear();
+                rewritten_meta.append(meta.substr(0, n)).append("?query=").append(meta.substr(n+1));
+                meta = rewritten_meta;
             }
-            const auto link_target = htmlLinkTarget(meta);
-            if (!link_target)
+            if (!isAllowedLinkTarget(meta))
             {
                 // Keep the label visible, but never create a browser-active
                 // URL from an unsupported Gemtext link target.
-                res += "<div class=\"link\">" + text + "</div>\n";
+                emit(sink, "<div class=\"link\">", text, "</div>\n");
                 continue;
             }
+            escaped.clear();
+            appendEscaped(escaped, meta);
+            const std::string& link_target = escaped;
             if(extended_mode) {
                 // If link to image. We convert it to <img> tag
                 const std::array<std::string_view, 7> img_exts = {".png", ".jpg", ".webp", ".gif", ".jpeg", ".bmp", ".svg"};
-                if(std::any_of(img_exts.begin(), img_exts.end(), [&meta](const std::string_view ext) { return meta.rfind(ext) != std::string::npos; })) {
+                if(containsExtension(meta, img_exts)) {
                     const std::string& alt = text;
-                    res += "<figure><a href=\"" + *link_target + "\"><img loading=\"lazy\" src=\"" + *link_target + "\" alt=\"" + alt + "\" title=\"Image: " + alt + "\"></a><figcaption>Image: "+alt+"</figcaption></figure>";
+                    emit(sink, "<figure><a href=\"", link_target, "\"><img loading=\"lazy\" src=\"", link_target, "\" alt=\"", alt, "\" title=\"Image: ", alt, "\"></a><figcaption>Image: ", alt, "</figcaption></figure>");
                     continue;
                 }
                 // link to audio (mp3, ogg, wav) => <audio> tag
                 const std::array<std::string_view, 4> audio_exts = {".mp3", ".ogg", ".wav", ".opus"};
-                if(std::any_of(audio_exts.begin(), audio_exts.end(), [&meta](const std::string_view ext) { return meta.rfind(ext) != std::string::npos; })) {
-                    res += "<figure><audio preload=\"none\" controls><source src=\"" + *link_target + "\">Your browser does not support the audio element.</audio><figcaption>Audio: "+text+"</figcaption></figure>";
+                if(containsExtension(meta, audio_exts)) {
+                    emit(sink, "<figure><audio preload=\"none\" controls><source src=\"", link_target, "\">Your browser does not support the audio element.</audio><figcaption>Audio: ", text, "</figcaption></figure>");
                     continue;
                 }
                 // link to video (webm, mkv, mp4) => <video> tag
                 const std::array<std::string_view, 3> video_exts = {".webm", ".mkv", ".mp4"};
-                if(std::any_of(video_exts.begin(), video_exts.end(), [&meta](const std::string_view ext) { return meta.rfind(ext) != std::string::npos; })) {
-                    res += "<figure><video style=\"max-width: 100%;\" preload=\"none\" controls><source src=\"" + *link_target + "\">Your browser does not support the video element.</video><figcaption>Video: "+text+"</figcaption></figure>";
+                if(containsExtension(meta, video_exts)) {
+                    emit(sink, "<figure><video style=\"max-width: 100%;\" preload=\"none\" controls><source src=\"", link_target, "\">Your browser does not support the video element.</video><figcaption>Video: ", text, "</figcaption></figure>");
                     continue;
                 }
 
                 // Youtube video embed
                 std::array<std::string_view, 3> youtube_url_prefixes = {"https://youtube.com/watch?v=", "https://youtu.be/", "https://www.youtube.com/watch?v="};
-                std::string youtube_id;
-                std::string timecode;
+                std::string_view youtube_id;
+                std::string_view timecode;
                 auto it = std::find_if(youtube_url_prefixes.begin(), youtube_url_prefixes.end(), [&meta](const std::string_view prefix) { return meta.find(prefix) == 0; });
                 if(it != youtube_url_prefixes.end()) {
                     size_t param_pos = meta.find_first_of("?&");
-                    size_t id_len = param_pos != std::string::npos ? param_pos-it->size() : std::string::npos;
+                    size_t id_len = param_pos != std::string_view::npos ? param_pos-it->size() : std::string_view::npos;
                     youtube_id = meta.substr(it->size(), id_len);
-                    if(param_pos != std::string::npos) {
+                    if(param_pos != std::string_view::npos) {
                         size_t t_pos = meta.find("t=", param_pos);
-                        if(t_pos != std::string::npos) {
+                        if(t_pos != std::string_view::npos) {
                             size_t t_end = meta.find('&', t_pos);
-                            size_t t_len = t_end != std::string::npos ? t_end-t_pos-2 : std::string::npos;
+                            size_t t_len = t_end != std::string_view::npos ? t_end-t_pos-2 : std::string_view::npos;
                             timecode = meta.substr(t_pos+2, t_len);
                         }
                     }
                 }
                 if(isSafeYoutubeId(youtube_id) && (timecode.empty() || isDecimal(timecode))) {
-                    auto embed_url = "https://www.youtube.com/embed/"+youtube_id;
-                    if(!timecode.empty())
-                        embed_url += "?start="+timecode;
-                    auto iframe = "<iframe width=\"560\" height=\"315\" src=\""+embed_url+"\" frameborder=\"0\" allow=\"accelerometer; autoplay; clipboard-write; encrypted-media; gyroscope; picture-in-picture\" allowfullscreen></iframe>";
-                    res += "<figure><div class=\"ytwrapper_outer\"><div class=\"ytwrapper\">"
-                        + iframe + "</div></div><figcaption>Youtube video: <a href=\""+*link_target+"\" target=\"_blank\">"+text+"</a></figcaption></figure>";
+                    emit(sink, "<figure><div class=\"ytwrapper_outer\"><div class=\"ytwrapper\">"
+                        "<iframe width=\"560\" height=\"315\" src=\"https://www.youtube.com/embed/", youtube_id,
+                        timecode.empty() ? "" : "?start=", timecode,
+                        "\" frameborder=\"0\" allow=\"accelerometer; autoplay; clipboard-write; encrypted-media; gyroscope; picture-in-picture\" allowfullscreen></iframe>"
+                        "</div></div><figcaption>Youtube video: <a href=\"", link_target, "\" target=\"_blank\">", text, "</a></figcaption></figure>");
                     continue;
                 }
             }
             // Open new tab if external link
             // HACK: Port TLGS's URL parser and use that to determine if external link
-            bool is_external = meta.find("://") != std::string::npos;
-            std::string frame_target = is_external ? "_blank" : "_self";
-            res += "<div class=\"link\"><a href=\""+*link_target+"\" target=\""+frame_target+"\">"+text+"</a></div>\n";
+            bool is_external = meta.find("://") != std::string_view::npos;
+            std::string_view frame_target = is_external ? "_blank" : "_self";
+            emit(sink, "<div class=\"link\"><a href=\"", link_target, "\" target=\"", frame_target, "\">", text, "</a></div>\n");
         }
-        else if(node.type == "preformatted_text") {
+        else if(node.type == GeminiNodeType::PreformattedText) {
             if(extended_mode) {
                 // detect tables and render as table
                 if(node.meta == "markdown" || node.meta == "md" || node.meta.empty()) {
                     // Detect if the block contains a Markdown table
-                    std::istringstream stream(text);
-                    std::string line;
                     std::vector<std::vector<std::string>> table;
                     bool is_table = true;
-                    while (std::getline(stream, line)) {
-                        std::istringstream line_stream(line);
-                        std::string cell;
+                    forEachField(text, '\n', [&](std::string_view line) {
                         std::vector<std::string> row;
-                        while (std::getline(line_stream, cell, '|')) {
-                            cell = trim(cell, " \t");
-                            row.push_back(renderPlainText(cell));
-                        }
-                        if (!row.empty()) {
-                            table.push_back(row);
-                        } else {
+                        forEachField(line, '|', [&row](std::string_view cell) {
+                            row.push_back(renderPlainText(trim(cell, " \t")));
+                            return true;
+                        });
+                        if (row.empty()) {
                             is_table = false;
-                            break;
+                            return false;
                         }
-                    }
+                        table.push_back(std::move(row));
+                        return true;
+                    });
                     if(table.size() <= 3) {
                         is_table = false;
                     }
@@ -478,54 +564,56 @@ std::pair<std::string, std::string> dremini::render2Html(const std::vector<Gemin
                     }
                     if (is_table) {
                         table.erase(table.begin() + 1);
-                        res += "<table>\n";
+                        sink.append("<table>\n");
                         for (const auto& row : table) {
-                            res += "<tr>";
+                            sink.append("<tr>");
                             for (const auto& cell : row) {
-                                res += "<td>" + cell + "</td>";
+                                emit(sink, "<td>", cell, "</td>");
                             }
-                            res += "</tr>\n";
+                            sink.append("</tr>\n");
                         }
-                        res += "</table>\n";
+                        sink.append("</table>\n");
                         continue;
                     }
                 }
             }
             bool meta_could_be_language = node.meta.find_first_of(" *'\"/\\()[]{};><`") == std::string::npos
-                && node.meta == utils::urlEncode(node.meta) && !node.meta.empty();
+                && !node.meta.empty() && node.meta == utils::urlEncode(std::string(node.meta));
             const bool has_caption = !node.meta.empty();
+            escaped.clear();
+            appendEscaped(escaped, node.meta);
             if (has_caption)
-            {
-                res += "<figure class=\"preformatted\"><figcaption>";
-                res += htmlEscape(node.meta);
-                res += "</figcaption>";
-            }
-            if(extended_mode && meta_could_be_language) {
-                res += "<pre><code class=\"language-"+htmlEscape(node.meta)+"\">"+text+"</code></pre>";
-            }
+                emit(sink, "<figure class=\"preformatted\"><figcaption>", escaped, "</figcaption>");
+            if(extended_mode && meta_could_be_language)
+                emit(sink, "<pre><code class=\"language-", escaped, "\">", text, "</code></pre>");
             else
-                res += "<pre><code>"+text+"</code></pre>";
+                emit(sink, "<pre><code>", text, "</code></pre>");
 
             if (has_caption)
-                res += "</figure>\n";
+                sink.append("</figure>\n");
             else
-                res += "\n";
+                sink.append("\n");
         }
-        if(node.type == "list") {
+        if(node.type == GeminiNodeType::List) {
             if(last_is_list == false)
-                res += "<ul>\n";
-            res += "  <li>"+(extended_mode ? renderPlainText(text) : text)+"</li>\n";
+                sink.append("<ul>\n");
+            sink.append("  <li>");
+            if(extended_mode)
+                emitPlainText(sink, text);
+            else
+                sink.append(text);
+            sink.append("</li>\n");
             last_is_list = true;
         }
         else {
             last_is_list = false;
         }
 
-        if(node.type == "quote")
+        if(node.type == GeminiNodeType::Quote)
         {
             if(last_is_backquote == false)
-                res += "<blockquote>\n";
-            res += (last_is_backquote ? "<br>" : "") + text;
+                sink.append("<blockquote>\n");
+            emit(sink, last_is_backquote ? "<br>" : "", text);
             last_is_backquote = true;
         }
         else {
@@ -533,46 +621,85 @@ std::pair<std::string, std::string> dremini::render2Html(const std::vector<Gemin
         }
     }
     if(last_is_backquote)
-        res += "</blockquote>\n";
+        sink.append("</blockquote>\n");
     else if(last_is_list)
-        res += "</ul>\n";
-    return {res, HttpViewData::htmlTranslate(title)};
+        sink.append("</ul>\n");
+    sink.flush();
+
+    std::string escaped_title;
+    appendEscaped(escaped_title, title);
+    return escaped_title;
+}
+
+ChunkedHtmlSink::ChunkedHtmlSink(ChunkCallback callback, std::size_t chunkSize)
+    : callback_(std::move(callback))
+    , chunkSize_(chunkSize)
+{
+    buffer_.reserve(chunkSize_);
+}
+
+void ChunkedHtmlSink::append(std::string_view html)
+{
+    if(buffer_.size() + html.size() > chunkSize_)
+        flush();
+    // Pieces too large to batch go out as they are
+    if(html.size() >= chunkSize_)
+        callback_(html);
+    else
+        buffer_.append(html);
+}
+
+void ChunkedHtmlSink::flush()
+{
+    if(buffer_.empty())
+        return;
+    callback_(buffer_);
+    buffer_.clear();
+}
+
+std::string dremini::render2Markdown(const std::vector<GeminiASTNode>& ast)
+{
+    return render2Markdown(viewNodes(ast));
 }
 
-std::string dremini::render2Markdown(const std::vector<GeminiASTNode>& ast) {
+std::string dremini::render2Markdown(const std::vector<GeminiNode>& ast) {
     std::string markdown;
     markdown.reserve(1024);
+    const auto appendLine = [&markdown](std::string_view prefix, std::string_view text) {
+        markdown.append(prefix).append(text).append("\n");
+    };
 
     // Render gemtext back to markdown
     for(const auto& node : ast) {
-        if(node.type == "preformatted_text" && node.meta != "") {
+        if(node.type == GeminiNodeType::PreformattedText && !node.meta.empty()) {
             // Magic table support
-            if((node.meta == "md" || node.meta == "markdown") && markdown.empty() == false && node.text[0] == '|') {
-                markdown += node.text + "\n";
+            if((node.meta == "md" || node.meta == "markdown") && markdown.empty() == false
+                && !node.text.empty() && node.text[0] == '|') {
+                appendLine("", node.text);
                 continue;
             }
 
-            markdown += "```" + node.meta + "\n";
-            markdown += node.text + "\n";
+            appendLine("```", node.meta);
+            appendLine("", node.text);
             markdown += "```\n";
         }
-        else if(node.type == "list") {
-            markdown += "- " + node.text + "\n";
+        else if(node.type == GeminiNodeType::List) {
+            appendLine("- ", node.text);
         }
-        else if(node.type == "quote") {
-            markdown += "> " + node.text + "\n";
+        else if(node.type == GeminiNodeType::Quote) {
+            appendLine("> ", node.text);
         }
-        else if(node.type == "link") {
-            markdown += "[" + node.text + "](" + node.meta + ")\n";
+        else if(node.type == GeminiNodeType::Link) {
+            markdown.append("[").append(node.text).append("](").append(node.meta).append(")\n");
         }
-        else if(node.type == "heading1") {
-            markdown += "# " + node.text + "\n";
+        else if(node.type == GeminiNodeType::Heading1) {
+            appendLine("# ", node.text);
         }
-        else if(node.type == "heading2") {
-            markdown += "## " + node.text + "\n";
+        else if(node.type == GeminiNodeType::Heading2) {
+            appendLine("## ", node.text);
         }
-        else if(node.type == "heading3") {
-            markdown += "### " + node.text + "\n";
+        else if(node.type == GeminiNodeType::Heading3) {
+            appendLine("### ", node.text);
         }
         else {
             // Some advanced rendering
@@ -581,7 +708,7 @@ std::string dremini::render2Markdown(const std::vector<GeminiASTNode>& ast) {
                 markdown += "---\n";
                 continue;
             }
-            markdown += node.text + "\n";
+            appendLine("", node.text);
         }
     }
     return markdown;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <string_view>
 
@@ -8,6 +10,52 @@
 namespace dremini
 {
 
+/**
+ * @brief Receives HTML from render2Html() piece by piece, as it is produced.
+ */
+class HtmlSink
+{
+public:
+    virtual ~HtmlSink() = default;
+    virtual void append(std::string_view html) = 0;
+    // Called once a document has been rendered
+    virtual void flush() {}
+};
+
+/**
+ * @brief Appends to a string the caller owns, e.g. one with capacity
+ *        reserved for the whole page.
+ */
+class StringHtmlSink : public HtmlSink
+{
+public:
+    explicit StringHtmlSink(std::string& out) : out_(out) {}
+    void append(std::string_view html) override { out_.append(html); }
+
+private:
+    std::string& out_;
+};
+
+/**
+ * @brief Batches HTML into chunks of at most `chunkSize` bytes, e.g. for a
+ *        streaming response. Pieces larger than that are passed on alone.
+ *        The view is only valid during the call.
+ */
+class ChunkedHtmlSink : public HtmlSink
+{
+public:
+    using ChunkCallback = std::function<void(std::string_view chunk)>;
+
+    explicit ChunkedHtmlSink(ChunkCallback callback, std::size_t chunkSize = 16384);
+    void append(std::string_view html) override;
+    void flush() override;
+
+private:
+    ChunkCallback callback_;
+    std::size_t chunkSize_;
+    std::string buffer_;
+};
+
 /**
  * @brief Render Gemini gemtext to HTML.
  * @param gmi_source The Gemini source.
@@ -27,6 +75,15 @@ namespace dremini
  */
 std::pair<std::string, std::string> render2Html(const std::string_view gemini_src, bool extended_mode = false);
 std::pair<std::string, std::string> render2Html(const std::vector<GeminiASTNode>& nodes, bool extended_mode = false);
+std::pair<std::string, std::string> render2Html(const std::vector<GeminiNode>& nodes, bool extended_mode = false);
+
+/**
+ * @brief Render Gemini gemtext to HTML into `sink`, without building the
+ *        page as a string first. Calls sink.flush() when done.
+ * @return The escaped title, as the second member of the pair above.
+ */
+std::string render2Html(const std::string_view gemini_src, HtmlSink& sink, bool extended_mode = false);
+std::string render2Html(const std::vector<GeminiNode>& nodes, HtmlSink& sink, bool extended_mode = false);
 
 /**
  * @brief Render Gemini gemtext to Markdown.
@@ -34,5 +91,6 @@ std::pair<std::string, std::string> render2Html(const std::vector<GeminiASTNode>
  * @return The rendered Markdown.
  */
 std::string render2Markdown(const std::vector<GeminiASTNode>& ast);
+std::string render2Markdown(const std::vector<GeminiNode>& ast);
 
 }
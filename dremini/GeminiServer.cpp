@@ -1,11 +1,22 @@
 #include <dremini/GeminiServer.hpp>
+#include <dremini/GeminiUrl.hpp>
 #include <drogon/HttpAppFramework.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstddef>
 #include <memory>
-#include <regex>
 #include <string>
 #include <trantor/net/TLSPolicy.h>
+#include <trantor/utils/TimingWheel.h>
+#include <vector>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
 
 using namespace drogon;
 using namespace dremini;
@@ -14,27 +25,80 @@ using namespace trantor;
 namespace
 {
 constexpr std::size_t kMaxRequestLineBytes = 1024;
+constexpr std::size_t kInlineBodyBytes = 16 * 1024;
 
+constexpr int kBusyRetrySeconds = 5;
+
+struct ReadDeadline;
+
+// Created once the TLS handshake completes and kept for the connection's
+// lifetime; a closing connection without it never finished its handshake.
 struct ConnectionState
 {
-    enum class Phase { CollectingTitanBody, Dispatched };
+    enum class Phase { ReadingRequestLine, CollectingTitanBody, FinishingTitanBody, Dispatched };
 
     explicit ConnectionState(Phase phase) : phase(phase) {}
 
     Phase phase;
+    bool rejected = false;
     HttpRequestPtr request;
     std::size_t expectedBodyBytes = 0;
-    std::string body;
+    std::size_t receivedBodyBytes = 0;
+    std::unique_ptr<TitanUploadSink> sink;
+    // The pending deadline for this phase, kept to re-arm it on progress
+    std::weak_ptr<ReadDeadline> readDeadline;
+    // Reading is paused until the Titan sink drains; the wait is the
+    // server's, so the read deadline does not apply meanwhile.
+    bool waitingForSink = false;
 };
 
+// Closes the connection when its timing wheel drops this entry, unless the
+// connection has left `phase` by then or is not being read.
+struct ReadDeadline
+{
+    ReadDeadline(const TcpConnectionPtr &conn, const std::shared_ptr<ConnectionState> &state)
+        : connection(conn), state(state), phase(state->phase)
+    {
+    }
+    ~ReadDeadline()
+    {
+        const auto conn = connection.lock();
+        const auto current = state.lock();
+        if (!conn || !current || current->phase != phase || current->waitingForSink || !conn->connected())
+            return;
+        LOG_DEBUG << "Read deadline expired for " << conn->peerAddr().toIpPort();
+        conn->forceClose();
+    }
+
+    std::weak_ptr<TcpConnection> connection;
+    std::weak_ptr<ConnectionState> state;
+    ConnectionState::Phase phase;
+};
+
+// Moves the connection past request parsing and releases what the parser held.
+std::shared_ptr<ConnectionState> markDispatched(const TcpConnectionPtr &conn)
+{
+    auto state = conn->getContext<ConnectionState>();
+    if (!state)
+    {
+        state = std::make_shared<ConnectionState>(ConnectionState::Phase::Dispatched);
+        conn->setContext(state);
+    }
+    state->phase = ConnectionState::Phase::Dispatched;
+    state->request.reset();
+    state->sink.reset();
+    return state;
+}
+
 }  // namespace
 
 GeminiServer::GeminiServer(EventLoop* loop,
                            const InetAddress& listenAddr,
                            const std::string& key,
                            const std::string& cert,
-                           TitanOptions titanOptions)
-    : loop_(loop), server_(loop, listenAddr, "GeminiServer"), titanOptions_(titanOptions)
+                           TitanOptions titanOptions,
+                           TlsOptions tlsOptions)
+    : loop_(loop), server_(loop, listenAddr, "GeminiServer"), titanOptions_(titanOptions), tlsOptions_(tlsOptions)
 {
     if(app().supportSSL() == false)
     {
@@ -48,49 +112,231 @@ GeminiServer::GeminiServer(EventLoop* loop,
     // application routes decide whether a certificate is necessary.
     tlsPolicy->setPeerCertificateRequest(false)
         .setCertificateVerification(false);
+    // OpenSSL issues session tickets unless told otherwise
+    if(!tlsOptions_.sessionTickets)
+        tlsPolicy->setConfCmds({{"Options", "-SessionTicket"}});
     server_.enableSSL(std::move(tlsPolicy));
     server_.setConnectionCallback([this](const TcpConnectionPtr& conn) {onConnection(conn);});
     server_.setRecvMessageCallback([this](const TcpConnectionPtr& conn, MsgBuffer* buf){onMessage(conn, buf);});
 }
 
+GeminiServer::~GeminiServer()
+{
+    if(ticketKeyRotationTimer_ != 0)
+        loop_->invalidateTimer(ticketKeyRotationTimer_);
+    // A TimingWheel has to be destroyed on its own loop
+    for(auto& [loop, wheel] : timingWheels_)
+        loop->runInLoop([wheel = std::move(wheel)]() mutable { wheel.reset(); });
+}
+
 void GeminiServer::onConnection(const TcpConnectionPtr& conn)
-{}
+{
+    if(!conn->connected())
+    {
+        if(conn->hasContext())
+        {
+            connections_.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+        // The handshake failed
+        metrics_->handshakesFailed.add();
+        if(limits_.maxHandshakes > 0)
+            handshakes_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+
+    metrics_->connectionsAccepted.add();
+
+    if(limits_.maxHandshakes > 0)
+        handshakes_.fetch_sub(1, std::memory_order_relaxed);
+    conn->setContext(std::make_shared<ConnectionState>(ConnectionState::Phase::ReadingRequestLine));
+    armReadDeadline(conn, timeouts_.requestLine);
+    const auto connections = connections_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if(limits_.maxConnections > 0 && connections > limits_.maxConnections)
+    {
+        LOG_DEBUG << "Connection limit reached, rejecting " << conn->peerAddr().toIp();
+        rejectRequest(conn, 44, std::to_string(kBusyRetrySeconds));
+        return;
+    }
+    if(limiter_)
+    {
+        const auto wait = limiter_->acquire(conn->peerAddr().toIp());
+        if(wait > 0)
+        {
+            LOG_DEBUG << "Rate limit reached, rejecting " << conn->peerAddr().toIp();
+            rejectRequest(conn, 44, std::to_string(static_cast<long>(std::ceil(wait))));
+        }
+    }
+}
+
+void GeminiServer::setConnectionLimits(const ConnectionLimits& limits)
+{
+    limits_ = limits;
+    if(limits_.requestsPerSecondPerIp > 0)
+        limiter_ = std::make_unique<PeerRateLimiter>(limits_.requestsPerSecondPerIp, limits_.burstPerIp);
+    else
+        limiter_.reset();
+}
+
+void GeminiServer::setReadTimeouts(const ReadTimeouts& timeouts)
+{
+    timeouts_ = timeouts;
+}
+
+void GeminiServer::armReadDeadline(const TcpConnectionPtr &conn, std::size_t seconds)
+{
+    if(seconds == 0)
+        return;
+    const auto wheel = timingWheels_.find(conn->getLoop());
+    if(wheel == timingWheels_.end())
+        return;
+    // The wheel holds the only reference, so the entry is destroyed, and
+    // the deadline checked, `seconds` ticks from now: O(1) per connection
+    // however many are idle.
+    const auto state = conn->getContext<ConnectionState>();
+    auto deadline = std::make_shared<ReadDeadline>(conn, state);
+    state->readDeadline = deadline;
+    wheel->second->insertEntry(seconds, std::move(deadline));
+}
+
+void GeminiServer::extendReadDeadline(const TcpConnectionPtr &conn, std::size_t seconds)
+{
+    if(seconds == 0)
+        return;
+    const auto wheel = timingWheels_.find(conn->getLoop());
+    if(wheel == timingWheels_.end())
+        return;
+    // Inserting the same entry again keeps it alive until the later slot
+    // drops it, without allocating per read. It is only gone if it expired
+    // while reading was paused.
+    if(auto deadline = conn->getContext<ConnectionState>()->readDeadline.lock())
+        wheel->second->insertEntry(seconds, std::move(deadline));
+    else
+        armReadDeadline(conn, seconds);
+}
 
 void GeminiServer::start()
 {
+    const auto maxTimeout = std::max(timeouts_.requestLine, timeouts_.titanBody);
+    if(maxTimeout > 0)
+    {
+        // Connections are served on loop_ itself unless IO loops were given
+        auto loops = ioLoops_.empty() ? std::vector<EventLoop*>{loop_} : ioLoops_;
+        for(auto loop : loops)
+            timingWheels_[loop] = std::make_shared<TimingWheel>(loop, maxTimeout, 1.0F,
+                                                                maxTimeout < 500 ? maxTimeout + 1 : 100);
+    }
+    if(timeouts_.idle > 0)
+        server_.kickoffIdleConnections(timeouts_.idle);
+    if(tlsOptions_.sessionTickets && tlsOptions_.ticketKeyRotationSeconds > 0)
+    {
+        // Ticket keys belong to the SSL context; a fresh context brings fresh keys
+        ticketKeyRotationTimer_ = loop_->runEvery(static_cast<double>(tlsOptions_.ticketKeyRotationSeconds),
+                                                  [this]() { server_.reloadSSL(); });
+    }
+    if(limits_.maxHandshakes > 0)
+    {
+        server_.setAfterAcceptSockOptCallback([this](int fd) {
+            // Runs before the TLS handshake, when no Gemini response can be
+            // sent yet. Shutting the socket down makes the handshake fail
+            // at once, and onConnection() then releases the slot.
+            if(handshakes_.fetch_add(1, std::memory_order_relaxed) >= limits_.maxHandshakes)
+            {
+                LOG_DEBUG << "Too many TLS handshakes in flight, refusing connection";
+#ifdef _WIN32
+                ::shutdown(fd, SD_BOTH);
+#else
+                ::shutdown(fd, SHUT_RDWR);
+#endif
+            }
+        });
+    }
     server_.start();
 }
 
 void GeminiServer::setIoThreadNum(size_t n)
 {
-    server_.setIoLoopNum(n);
+    // Owning the pool lets start() know the IO loops
+    setIoLoopThreadPool(std::make_shared<EventLoopThreadPool>(n, "GeminiServerIoLoop"));
 }
 
 void GeminiServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
 {
-    if (const auto state = conn->getContext<ConnectionState>())
+    const auto state = conn->getContext<ConnectionState>();
+    if (!state || state->phase == ConnectionState::Phase::Dispatched ||
+        state->phase == ConnectionState::Phase::FinishingTitanBody)
     {
-        if (state->phase == ConnectionState::Phase::Dispatched)
-        {
+        // Clients whose request was refused early keep sending it; only
+        // unexpected data after a dispatched request is worth a warning.
+        if (!state || !state->rejected)
             LOG_WARN << "Extra message received for Gemini/Titan connection";
-            return;
-        }
-
-        const auto remaining = state->expectedBodyBytes - state->body.size();
+        return;
+    }
+    if (state->phase == ConnectionState::Phase::CollectingTitanBody)
+    {
+        const auto remaining = state->expectedBodyBytes - state->receivedBodyBytes;
         if (buf->readableBytes() > remaining)
         {
             rejectRequest(conn, 59, "Titan request sent more bytes than declared");
             return;
         }
-        state->body.append(buf->peek(), buf->readableBytes());
+        // Chunks go to the sink as they arrive, so nothing but the sink's
+        // own storage is held for the upload.
+        if (buf->readableBytes() != 0 &&
+            !state->sink->write(std::string_view(buf->peek(), buf->readableBytes())))
+        {
+            rejectRequest(conn, 40, "Titan upload could not be stored");
+            return;
+        }
+        state->receivedBodyBytes += buf->readableBytes();
+        metrics_->titanBytesReceived.add(buf->readableBytes());
         buf->retrieveAll();
-        if (state->body.size() != state->expectedBodyBytes) return;
+        if (state->receivedBodyBytes != state->expectedBodyBytes)
+        {
+            // The body deadline only catches stalled uploads, so any
+            // progress re-arms it
+            extendReadDeadline(conn, timeouts_.titanBody);
+            // Stop reading while the sink catches up with a slow disk
+            if (state->sink->congested())
+            {
+                conn->stopRecv();
+                state->waitingForSink = true;
+                state->sink->whenDrained([this, weakConn = std::weak_ptr<TcpConnection>(conn)]() {
+                    if (const auto conn = weakConn.lock())
+                        conn->getLoop()->queueInLoop([this, conn]() {
+                            if (!conn->connected()) return;
+                            // The client gets a full titan_body from here
+                            conn->getContext<ConnectionState>()->waitingForSink = false;
+                            extendReadDeadline(conn, timeouts_.titanBody);
+                            conn->startRecv();
+                        });
+                });
+            }
+            return;
+        }
 
-        state->request->setBody(std::move(state->body));
-        dispatchRequest(conn, std::move(state->request));
+        // The sink may still be writing; the request is dispatched once it
+        // is done, back on the connection's loop.
+        state->phase = ConnectionState::Phase::FinishingTitanBody;
+        state->sink->finishAsync(*state->request,
+                                 [this, weakConn = std::weak_ptr<TcpConnection>(conn), state](bool stored) {
+            const auto conn = weakConn.lock();
+            if (!conn) return;
+            conn->getLoop()->queueInLoop([this, conn, state, stored]() {
+                if (!conn->connected()) return;
+                if (!stored)
+                {
+                    rejectRequest(conn, 40, "Titan upload could not be stored");
+                    return;
+                }
+                state->sink.reset();
+                dispatchRequest(conn, std::move(state->request));
+            });
+        });
         return;
     }
 
+    const auto parseStart = std::chrono::steady_clock::now();
     const char* crlf = buf->findCRLF();
     if (crlf == nullptr)
     {
@@ -105,40 +351,33 @@ void GeminiServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
         return;
     }
 
-    std::string url(buf->peek(), std::distance(buf->peek(), crlf));
-    buf->retrieveUntil(crlf);
-    buf->retrieve(2);
-
-    static const std::regex re(R"(([a-z]+):\/\/([^\/:]+)(?:\:([0-9]+))?(\/$|$|\/[^?]*)(?:\?(.*))?)");
-    std::smatch match;
-    if(!std::regex_match(url, match, re))
+    const auto url = parseGeminiUrl(std::string_view(buf->peek(), requestLineBytes - 2));
+    if(!url)
     {
         LOG_TRACE << "Invalid request";
         rejectRequest(conn, 59, "Invalid request");
         return;
     }
 
-    const std::string scheme = match[1];
-    std::string authority = match[2];
-    if (match[3].matched)
-        authority += ":" + match[3].str();
-    std::string path = match[4];
-    std::string query = match[5];
+    const bool isTitan = url->hasScheme("titan");
+    std::string path = url->path.empty() ? std::string("/") : std::string(url->path);
     HttpRequestPtr req = HttpRequest::newHttpRequest();
-    if(path.empty())
-        path = "/";
     req->setMethod(Get);
     req->setPath(path);
     req->setPeerCertificate(conn->peerCertificate());
-    req->addHeader("protocol", scheme == "titan" ? "titan" : "gemini");
-    req->getAttributes()->insert(kRequestAuthorityAttribute, std::move(authority));
-    if(!query.empty())
-        req->setParameter("query", query);
-
-    LOG_DEBUG << "Gemini/Titan request: scheme=" << scheme << " path=" << path
-              << " query_present=" << !query.empty();
-
-    if (scheme == "titan")
+    req->addHeader("protocol", isTitan ? "titan" : "gemini");
+    req->getAttributes()->insert(kRequestAuthorityAttribute, std::string(url->authority));
+    if(!url->query.empty())
+        req->setParameter("query", std::string(url->query));
+
+    LOG_DEBUG << "Gemini/Titan request: scheme=" << url->scheme << " path=" << path
+              << " query_present=" << !url->query.empty();
+    // The views in `url` point into the receive buffer and are not used
+    // past this point.
+    buf->retrieve(requestLineBytes);
+    metrics_->requestLineParseTime.observe(std::chrono::steady_clock::now() - parseStart);
+
+    if (isTitan)
     {
         if (!titanOptions_.enabled)
         {
@@ -178,13 +417,23 @@ void GeminiServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
         if (titan.request->token)
             req->addHeader("titan-token", *titan.request->token);
 
-        auto state = std::make_shared<ConnectionState>(ConnectionState::Phase::CollectingTitanBody);
+        state->phase = ConnectionState::Phase::CollectingTitanBody;
         state->request = std::move(req);
         state->expectedBodyBytes = titan.request->size;
-        // The declared size is peer-controlled. Do not reserve it: memory is
-        // acquired only for bytes actually received, under the server-owned
-        // maximum enforced by parseTitanRequest().
-        conn->setContext(std::move(state));
+        if (titanOptions_.sinkFactory)
+            state->sink = titanOptions_.sinkFactory(*titan.request);
+        if (!state->sink)
+        {
+            // The declared size is peer-controlled, but it is bounded by the
+            // server-owned maximum enforced by parseTitanRequest().
+            if (titan.request->size > titanOptions_.maxMemoryBodyBytes)
+                state->sink = newTitanFileSink(titanOptions_.spoolDirectory.empty()
+                                                   ? app().getUploadPath() + "/titan"
+                                                   : titanOptions_.spoolDirectory);
+            else
+                state->sink = newTitanMemorySink();
+        }
+        armReadDeadline(conn, timeouts_.titanBody);
         onMessage(conn, buf);
         return;
     }
@@ -200,30 +449,50 @@ void GeminiServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
         return;
     }
     LOG_TRACE << "Gemini request received";
-    dispatchRequest(conn, std::move(req));
+    // Responses may depend on the client's identity, so requests made with a
+    // certificate neither use nor fill the cache.
+    const bool cacheable = responseCache_ && !conn->peerCertificate();
+    if(cacheable)
+    {
+        const auto& authority = req->getAttributes()->get<std::string>(kRequestAuthorityAttribute);
+        if(auto cached = responseCache_->find(authority, req->path(), req->getParameter("query")))
+        {
+            markDispatched(conn);
+            sendCachedResponse(conn, std::move(cached));
+            return;
+        }
+    }
+    dispatchRequest(conn, std::move(req), cacheable);
 }
 
-void GeminiServer::dispatchRequest(const TcpConnectionPtr &conn, HttpRequestPtr req)
+void GeminiServer::dispatchRequest(const TcpConnectionPtr &conn, HttpRequestPtr req, bool cacheable)
 {
-    conn->setContext(std::make_shared<ConnectionState>(ConnectionState::Phase::Dispatched));
-    int idx = roundRobbinIdx_.fetch_add(1, std::memory_order_relaxed);
-    if(idx > 0x7ffff) // random large number
+    markDispatched(conn);
+    const auto dispatched = std::chrono::steady_clock::now();
+    auto respond = [conn, req, dispatched, cacheable, this](const HttpResponsePtr& resp) {
+        metrics_->handlerLatency.observe(std::chrono::steady_clock::now() - dispatched);
+        // Stale copies of an uploaded resource must not outlive the upload
+        if(responseCache_ && req->method() == Post)
+            responseCache_->invalidate(req->path());
+        sendResponseBack(conn, resp, cacheable ? req : nullptr);
+    };
+    if(useDrogonIoLoops_)
     {
-        // XXX: Properbally data race. But it happens rare enough
-        roundRobbinIdx_.store(0, std::memory_order_relaxed);
+        // Already on a Drogon IO loop, which owns the connection as well.
+        app().forward(req, std::move(respond));
+        return;
     }
-    idx = idx % app().getThreadNum();
+    // Unsigned overflow wraps, so the counter never needs resetting
+    const auto idx = roundRobbinIdx_.fetch_add(1, std::memory_order_relaxed) % app().getThreadNum();
     // Drogon only accepts request from it's own event loops
-    app().getIOLoop(idx)->runInLoop([req=std::move(req), conn=std::move(conn), this](){
-        app().forward(req, [req=std::move(req), conn=std::move(conn), this](const HttpResponsePtr& resp){
-            sendResponseBack(conn, resp);
-        });
+    app().getIOLoop(idx)->runInLoop([req=std::move(req), respond=std::move(respond)](){
+        app().forward(req, respond);
     });
 }
 
 void GeminiServer::rejectRequest(const TcpConnectionPtr &conn, int status, std::string meta)
 {
-    conn->setContext(std::make_shared<ConnectionState>(ConnectionState::Phase::Dispatched));
+    markDispatched(conn)->rejected = true;
     auto response = HttpResponse::newHttpResponse();
     response->setStatusCode(static_cast<HttpStatusCode>(status));
     response->addHeader("meta", std::move(meta));
@@ -234,9 +503,41 @@ void GeminiServer::rejectRequest(const TcpConnectionPtr &conn, int status, std::
 void GeminiServer::setIoLoopThreadPool(const std::shared_ptr<EventLoopThreadPool>& pool)
 {
     server_.setIoLoopThreadPool(pool);
+    ioLoops_ = pool->getLoops();
+}
+
+void GeminiServer::setMetrics(std::shared_ptr<ServerMetrics> metrics)
+{
+    metrics_ = std::move(metrics);
 }
 
-void GeminiServer::sendResponseBack(const TcpConnectionPtr& conn, const HttpResponsePtr& resp)
+void GeminiServer::useDrogonIoLoops()
+{
+    std::vector<EventLoop*> loops;
+    loops.reserve(app().getThreadNum());
+    for(size_t i = 0; i < app().getThreadNum(); i++)
+        loops.push_back(app().getIOLoop(i));
+    server_.setIoLoops(loops);
+    ioLoops_ = std::move(loops);
+    useDrogonIoLoops_ = true;
+}
+
+void GeminiServer::setResponseCache(std::shared_ptr<ResponseCache> cache)
+{
+    responseCache_ = std::move(cache);
+}
+
+void GeminiServer::sendCachedResponse(const TcpConnectionPtr& conn, std::shared_ptr<const std::string> response)
+{
+    const auto status = (*response)[0] - '0';
+    if(status >= 1 && static_cast<std::size_t>(status) <= metrics_->responses.size())
+        metrics_->responses[status - 1].add();
+    // Already on the connection's loop, and the cache keeps the bytes alive
+    conn->send(response->data(), response->size());
+    conn->shutdown();
+}
+
+void GeminiServer::sendResponseBack(const TcpConnectionPtr& conn, const HttpResponsePtr& resp, const HttpRequestPtr& cacheFor)
 {
     LOG_TRACE << "Sending response back";
     const int httpStatus = resp->statusCode();
@@ -251,81 +552,130 @@ void GeminiServer::sendResponseBack(const TcpConnectionPtr& conn, const HttpResp
         status = 43;
     else if(httpStatus == 429) // 429 (Too Many Requests) -> 44 (Slow Down)
         status = 44;
-    else if(httpStatus%100 == 2) // Success -> Success
+    else if(httpStatus/100 == 2) // Success -> Success
         status = 20;
-    else if(httpStatus%100 == 4) // Client Error -> Permanent Failure
+    else if(httpStatus/100 == 4) // Client Error -> Permanent Failure
         status = 50;
-    else if(httpStatus%100 == 5) // Server Error -> Temporary Failure
+    else if(httpStatus/100 == 5) // Server Error -> Temporary Failure
         status = 40;
     else
         status = httpStatus/100*10;
-    std::string respHeader;
 
     assert(status < 100 && status >= 10);
-
+    if(static_cast<std::size_t>(status/10) <= metrics_->responses.size())
+        metrics_->responses[status/10 - 1].add();
+
+    // Bound to a reference so the view below stays valid whether Drogon
+    // returns the content type by reference or by value.
+    const auto &contentType = resp->contentTypeString();
+    // Every branch picks a view of a header owned by `resp`, or a literal,
+    // so the status line is assembled with a single allocation below.
+    std::string_view meta;
     if(status/10 == 1)
     {
-        std::string meta = resp->getHeader("meta");
+        meta = resp->getHeader("meta");
         if(meta.empty())
             meta = "Input";
-        respHeader = std::to_string(status) + " " + meta + "\r\n";
     }
     else if(status/10 == 2)
     {
-        auto ct = resp->contentTypeString();
-        if(ct != "")
-            respHeader = std::to_string(status) + " " + ct + "\r\n";
-        else
-            respHeader = std::to_string(status) + " application/octet-stream\r\n";
+        meta = contentType;
+        if(meta.empty())
+            meta = "application/octet-stream";
     }
     else if(status/10 == 3)
     {
-        if(!resp->getHeader("location").empty())
-            respHeader = std::to_string(status) + " " + resp->getHeader("location") + "\r\n";
-        else
-            respHeader = std::to_string(status) + " " + resp->getHeader("meta") + "\r\n";
+        meta = resp->getHeader("location");
+        if(meta.empty())
+            meta = resp->getHeader("meta");
     }
     else if(status == 44)
     {
-        std::string meta = resp->getHeader("Retry-After");
+        meta = resp->getHeader("Retry-After");
         if(meta.empty())
             meta = resp->getHeader("meta");
         if(meta.empty())
             meta = "30"; // XXX: Default 30s retry
-        respHeader = std::to_string(status) + " " + meta + "\r\n";
     }
     else if(status/10 == 4)
     {
-        std::string meta = resp->getHeader("meta");
+        meta = resp->getHeader("meta");
         if(meta.empty())
             meta = "Temporary Failure";
-        respHeader = std::to_string(status) + " " + meta + "\r\n";
     }
     else if(status/10 == 5)
     {
-        std::string meta = resp->getHeader("meta");
+        meta = resp->getHeader("meta");
         if(meta.empty())
             meta = "Permanent Failure";
-        respHeader = std::to_string(status) + " " + meta + "\r\n";
     }
     else
     {
-        respHeader = std::to_string(status) + " " + resp->getHeader("meta") + "\r\n";
+        meta = resp->getHeader("meta");
     }
-    conn->send(respHeader);
 
-    if(status/10 == 2)
+    const bool hasBody = status/10 == 2;
+    const bool isStream = hasBody && resp->sendfileName().empty() && resp->streamCallback();
+    const auto body = hasBody && resp->sendfileName().empty() && !isStream ? resp->body() : std::string_view{};
+    // Small bodies ride in the same buffer (and TLS record) as the header.
+    // Larger ones are handed to the connection straight from the response.
+    const bool inlineBody = body.size() <= kInlineBodyBytes;
+    std::string header;
+    header.reserve(meta.size() + 5 + (inlineBody ? body.size() : 0));
+    header += static_cast<char>('0' + status/10);
+    header += static_cast<char>('0' + status%10);
+    header += ' ';
+    header += meta;
+    header += "\r\n";
+    if(inlineBody)
+        header += body;
+
+    if(cacheFor && responseCache_ && !isStream && resp->sendfileName().empty())
     {
-        const std::string &sendfileName = resp->sendfileName();
-        if (!sendfileName.empty())
+        const auto& ttl = resp->getHeader(kGeminiCacheTtlHeader);
+        const auto seconds = ttl.empty() ? 0 : std::atol(ttl.c_str());
+        if(seconds > 0)
         {
-            const auto &range = resp->sendfileRange();
-            conn->sendFile(sendfileName.c_str(), range.first, range.second);
+            auto cached = std::make_shared<std::string>(header);
+            if(!inlineBody)
+                cached->append(body);
+            const auto& authority = cacheFor->getAttributes()->get<std::string>(kRequestAuthorityAttribute);
+            responseCache_->insert(authority, cacheFor->path(), cacheFor->getParameter("query"),
+                                   std::move(cached), std::chrono::seconds(seconds));
         }
-        else if(resp->body().size() != 0)
+    }
+
+    auto send = [conn, resp, header = std::move(header), hasBody, isStream, inlineBody]() {
+        conn->send(header.data(), header.size());
+        if(hasBody)
         {
-            conn->send(std::string(resp->body()));
+            const std::string &sendfileName = resp->sendfileName();
+            if (!sendfileName.empty())
+            {
+                const auto &range = resp->sendfileRange();
+                conn->sendFile(sendfileName.c_str(), range.first, range.second);
+            }
+            else if(isStream)
+            {
+                // trantor pulls from the callback only as the socket drains,
+                // so generated or proxied bodies are never fully buffered.
+                conn->sendStream(resp->streamCallback());
+            }
+            else if(!inlineBody)
+            {
+                // `resp` owns the body and outlives this call, so the bytes
+                // go to the TLS layer without an intermediate copy.
+                const auto body = resp->body();
+                conn->send(body.data(), body.size());
+            }
         }
-    }
-    conn->shutdown();
+        conn->shutdown();
+    };
+    // Sending from the connection's own loop lets trantor write the body
+    // directly instead of copying it into a cross-thread queue.
+    auto loop = conn->getLoop();
+    if(loop->isInLoopThread())
+        send();
+    else
+        loop->queueInLoop(std::move(send));
 }
@@ -1,14 +1,27 @@
 #pragma once
 
+#include <dremini/Metrics.hpp>
+#include <dremini/RateLimiter.hpp>
+#include <dremini/ResponseCache.hpp>
 #include <dremini/Titan.hpp>
 #include <drogon/HttpRequest.h>
 #include <drogon/utils/FunctionTraits.h>
+#include <atomic>
+#include <limits>
 #include <memory>
+#include <string>
 #include <trantor/net/EventLoop.h>
 #include <trantor/net/EventLoopThreadPool.h>
 #include <trantor/net/InetAddress.h>
 #include <trantor/net/TcpServer.h>
 #include <trantor/utils/NonCopyable.h>
+#include <unordered_map>
+#include <vector>
+
+namespace trantor
+{
+class TimingWheel;
+}
 
 namespace dremini
 {
@@ -16,6 +29,51 @@ struct TitanOptions
 {
     bool enabled = false;
     std::size_t maxUploadBytes = 4096;
+    // Uploads declaring more bytes than this are streamed into a file in
+    // spoolDirectory (Drogon's upload path when empty) instead of memory.
+    std::size_t maxMemoryBodyBytes = std::numeric_limits<std::size_t>::max();
+    std::string spoolDirectory;
+    // Takes precedence over the two options above when it returns a sink.
+    TitanUploadSinkFactory sinkFactory;
+};
+
+// Admission limits for a listener. Zero disables a limit.
+struct ConnectionLimits
+{
+    // Established connections. Further ones are answered with 44.
+    std::size_t maxConnections = 0;
+    // Accepted connections still in their TLS handshake. Further ones are
+    // closed before the handshake, as no Gemini response can be sent yet.
+    std::size_t maxHandshakes = 0;
+    // Token bucket per peer IP, charged once per connection. Peers over the
+    // limit are answered with 44 and the seconds until they may retry.
+    double requestsPerSecondPerIp = 0;
+    double burstPerIp = 0;
+};
+
+struct TlsOptions
+{
+    // Stateless resumption through TLS session tickets. Sessions are also
+    // kept in the server-side cache shared by all connections of a listener.
+    bool sessionTickets = true;
+    // Seconds between ticket key rotations; 0 keeps one key for the life of
+    // the server. Rotating reloads the certificate and key and drops cached
+    // sessions, so clients do one full handshake afterwards.
+    std::size_t ticketKeyRotationSeconds = 0;
+};
+
+// Deadlines, in seconds, for reading a request. Zero disables a deadline.
+struct ReadTimeouts
+{
+    // From the end of the TLS handshake until the request line is complete.
+    // Trickling the line byte by byte does not extend it.
+    std::size_t requestLine = 30;
+    // Longest pause while a Titan body arrives. Each chunk restarts it, so
+    // slow but steady uploads of any size complete.
+    std::size_t titanBody = 120;
+    // Closes connections without any traffic for this long, such as clients
+    // that stop reading their response.
+    std::size_t idle = 0;
 };
 
 class GeminiServer : public trantor::NonCopyable
@@ -26,24 +84,68 @@ public:
             const trantor::InetAddress& listenAddr,
             const std::string& key,
             const std::string& cert,
-            TitanOptions titanOptions = {});
+            TitanOptions titanOptions = {},
+            TlsOptions tlsOptions = {});
+    ~GeminiServer();
     void start();
     void setIoThreadNum(size_t n);
+    // Must be called before start()
+    void setConnectionLimits(const ConnectionLimits& limits);
+    // Must be called before start()
+    void setReadTimeouts(const ReadTimeouts& timeouts);
     void setIoLoopThreadPool(const std::shared_ptr<trantor::EventLoopThreadPool>& pool);
+    // Servers given the same instance report into the same metrics. Must be
+    // called before start()
+    void setMetrics(std::shared_ptr<ServerMetrics> metrics);
+    const ServerMetrics& metrics() const { return *metrics_; }
+    // Serve repeated Gemini requests from `cache` without routing them.
+    // Responses are stored when the handler sets kGeminiCacheTtlHeader.
+    // Successful Titan uploads invalidate the uploaded path. Must be called
+    // before start()
+    void setResponseCache(std::shared_ptr<ResponseCache> cache);
+    /**
+     * @brief Serve connections on Drogon's own IO loops instead of a separate
+     *        pool. Requests are then forwarded to Drogon on the loop that owns
+     *        the connection, avoiding a thread hop per request and per response.
+     *        Must be called before start().
+     */
+    void useDrogonIoLoops();
 
 protected:
-    void sendResponseBack(const trantor::TcpConnectionPtr& conn, const drogon::HttpResponsePtr& resp);
+    // When `cacheFor` is set and the response opts in, the serialised
+    // response is also stored in the response cache under that request.
+    void sendResponseBack(const trantor::TcpConnectionPtr& conn,
+                          const drogon::HttpResponsePtr& resp,
+                          const drogon::HttpRequestPtr& cacheFor = nullptr);
+    void sendCachedResponse(const trantor::TcpConnectionPtr& conn, std::shared_ptr<const std::string> response);
     void onConnection(const trantor::TcpConnectionPtr &conn);
     void onMessage(const trantor::TcpConnectionPtr &conn, trantor::MsgBuffer *buf);
     void dispatchRequest(const trantor::TcpConnectionPtr &conn,
-                         drogon::HttpRequestPtr request);
+                         drogon::HttpRequestPtr request,
+                         bool cacheable = false);
     void rejectRequest(const trantor::TcpConnectionPtr &conn,
                        int status,
                        std::string meta);
+    void armReadDeadline(const trantor::TcpConnectionPtr &conn, std::size_t seconds);
+    void extendReadDeadline(const trantor::TcpConnectionPtr &conn, std::size_t seconds);
     trantor::EventLoop* loop_;
     trantor::TcpServer server_;
     TitanOptions titanOptions_;
-    std::atomic<int> roundRobbinIdx_{0};
+    std::atomic<unsigned> roundRobbinIdx_{0};
+    ConnectionLimits limits_;
+    std::unique_ptr<PeerRateLimiter> limiter_;
+    std::atomic<std::size_t> connections_{0};
+    std::atomic<std::size_t> handshakes_{0};
+    ReadTimeouts timeouts_;
+    TlsOptions tlsOptions_;
+    std::shared_ptr<ServerMetrics> metrics_ = std::make_shared<ServerMetrics>();
+    std::shared_ptr<ResponseCache> responseCache_;
+    trantor::TimerId ticketKeyRotationTimer_{0};
+    std::vector<trantor::EventLoop*> ioLoops_;
+    // One wheel per IO loop, each only touched from its own loop. Built by
+    // start() and read-only afterwards.
+    std::unordered_map<trantor::EventLoop*, std::shared_ptr<trantor::TimingWheel>> timingWheels_;
+    bool useDrogonIoLoops_ = false;
 };
 
 }
@@ -1,11 +1,14 @@
 #include <dremini/GeminiServerPlugin.hpp>
 #include <dremini/GeminiServer.hpp>
 #include <dremini/GeminiRenderer.hpp>
+#include <dremini/Metrics.hpp>
 #include <dremini/Titan.hpp>
 #include <drogon/HttpAppFramework.h>
 #include <drogon/utils/Utilities.h>
 #include <json/value.h>
+#include <algorithm>
 #include <cstdint>
+#include <initializer_list>
 #include <memory>
 #include <string>
 #include <trantor/net/EventLoopThreadPool.h>
@@ -253,6 +256,41 @@ static const std::string_view certificateRequiredTemplate = R"zz(
 </html>
 )zz";
 
+static constexpr std::string_view placeholderPrefix = "__THIS_IS_";
+static constexpr std::string_view titlePlaceholder = "__THIS_IS_THIS_TITLE_123456789__";
+static constexpr std::string_view cssPlaceholder = "__THIS_IS_THIS_CSS_123456789__";
+static constexpr std::string_view bodyPlaceholder = "__THIS_IS_THIS_BODY_123456789__";
+static constexpr std::string_view typePlaceholder = "__THIS_IS_TYPE_123456789__";
+
+// Appends `page` to `out` with its placeholders replaced by `values`, in one
+// pass rather than a copy and a replaceAll() per placeholder
+static void appendTemplate(std::string& out, std::string_view page,
+                           std::initializer_list<std::pair<std::string_view, std::string_view>> values)
+{
+    size_t pos = 0;
+    while(true)
+    {
+        const auto at = page.find(placeholderPrefix, pos);
+        if(at == std::string_view::npos)
+        {
+            out.append(page.substr(pos));
+            return;
+        }
+        out.append(page.substr(pos, at - pos));
+        const auto value = std::find_if(values.begin(), values.end(), [&](const auto& placeholder) {
+            return page.substr(at, placeholder.first.size()) == placeholder.first;
+        });
+        if(value == values.end())
+        {
+            out.append(placeholderPrefix);
+            pos = at + placeholderPrefix.size();
+            continue;
+        }
+        out.append(value->second);
+        pos = at + value->first.size();
+    }
+}
+
 static std::optional<int> try_stoi(const std::string_view sv)
 {
     try
@@ -267,6 +305,8 @@ static std::optional<int> try_stoi(const std::string_view sv)
 
 void GeminiServerPlugin::initAndStart(const Json::Value& config)
 {
+    // Sharing Drogon's IO loops saves a thread hop per request and response
+    const bool useDrogonIoLoops = config.get("use_drogon_io_loops", false).asBool();
     int numThread = config.get("numThread", 1).asInt();
     if(numThread < 0)
     {
@@ -274,10 +314,18 @@ void GeminiServerPlugin::initAndStart(const Json::Value& config)
         exit(1);
     }
 
-    pool_ = std::make_shared<trantor::EventLoopThreadPool>(numThread, "GeminiServerThreadPool");
+    if(!useDrogonIoLoops)
+        pool_ = std::make_shared<trantor::EventLoopThreadPool>(numThread, "GeminiServerThreadPool");
 
     installTitanRoutingAdvice();
 
+    const auto& responseCache = config["response_cache"];
+    if(!responseCache.isNull())
+    {
+        const auto maxBytes = responseCache.get("max_bytes", static_cast<Json::UInt64>(64 * 1024 * 1024)).asUInt64();
+        responseCache_ = std::make_shared<ResponseCache>(static_cast<std::size_t>(maxBytes));
+    }
+
 
     const auto& listeners = config["listeners"];
     if(listeners.isNull())
@@ -322,6 +370,45 @@ void GeminiServerPlugin::initAndStart(const Json::Value& config)
                     exit(1);
                 }
                 titanOptions.maxUploadBytes = static_cast<std::size_t>(maximum);
+                if (titan.isMember("max_memory_body_bytes"))
+                {
+                    const auto memory = titan["max_memory_body_bytes"].asInt64();
+                    if (memory < 0)
+                    {
+                        LOG_FATAL << "Titan max_memory_body_bytes must not be negative";
+                        exit(1);
+                    }
+                    titanOptions.maxMemoryBodyBytes = static_cast<std::size_t>(memory);
+                }
+                titanOptions.spoolDirectory = titan.get("spool_directory", "").asString();
+            }
+
+            ConnectionLimits limits;
+            const auto& limitConfig = listener.isMember("limits") ? listener["limits"] : config["limits"];
+            if (!limitConfig.isNull())
+            {
+                limits.maxConnections = limitConfig.get("max_connections", 0).asUInt64();
+                limits.maxHandshakes = limitConfig.get("max_handshakes", 0).asUInt64();
+                limits.requestsPerSecondPerIp = limitConfig.get("requests_per_second_per_ip", 0.0).asDouble();
+                limits.burstPerIp = limitConfig.get("burst_per_ip", limits.requestsPerSecondPerIp).asDouble();
+            }
+
+            TlsOptions tlsOptions;
+            const auto& tls = listener.isMember("tls") ? listener["tls"] : config["tls"];
+            if (!tls.isNull())
+            {
+                tlsOptions.sessionTickets = tls.get("session_tickets", tlsOptions.sessionTickets).asBool();
+                tlsOptions.ticketKeyRotationSeconds = tls.get(
+                    "ticket_key_rotation_seconds", static_cast<Json::UInt64>(tlsOptions.ticketKeyRotationSeconds)).asUInt64();
+            }
+
+            ReadTimeouts timeouts;
+            const auto& timeoutConfig = listener.isMember("timeouts") ? listener["timeouts"] : config["timeouts"];
+            if (!timeoutConfig.isNull())
+            {
+                timeouts.requestLine = timeoutConfig.get("request_line", static_cast<Json::UInt64>(timeouts.requestLine)).asUInt64();
+                timeouts.titanBody = timeoutConfig.get("titan_body", static_cast<Json::UInt64>(timeouts.titanBody)).asUInt64();
+                timeouts.idle = timeoutConfig.get("idle", static_cast<Json::UInt64>(timeouts.idle)).asUInt64();
             }
 
             bool isV6 = ip.find(":") != std::string::npos;
@@ -331,12 +418,34 @@ void GeminiServerPlugin::initAndStart(const Json::Value& config)
                 LOG_FATAL << ip << " is not a valid IP address";
             }
 
-            auto server = std::make_unique<GeminiServer>(app().getLoop(), addr, key, cert, titanOptions);
-            server->setIoLoopThreadPool(pool_);
+            auto server = std::make_unique<GeminiServer>(app().getLoop(), addr, key, cert, titanOptions, tlsOptions);
+            if(useDrogonIoLoops)
+                server->useDrogonIoLoops();
+            else
+                server->setIoLoopThreadPool(pool_);
+            server->setConnectionLimits(limits);
+            server->setReadTimeouts(timeouts);
+            server->setMetrics(metrics_);
+            server->setResponseCache(responseCache_);
             server->start();
             servers_.emplace_back(std::move(server));
         }
     }
+    // Gemini requests are forwarded to Drogon as well, so the route answers
+    // over both HTTP and Gemini.
+    const auto metricsPath = config.get("metrics_path", "").asString();
+    if(!metricsPath.empty())
+    {
+        app().registerHandler(metricsPath,
+            [metrics = metrics_](const HttpRequestPtr&, std::function<void(const HttpResponsePtr&)>&& callback) {
+                auto resp = HttpResponse::newHttpResponse();
+                resp->setContentTypeString("text/plain; version=0.0.4");
+                resp->setBody(renderPrometheusText(*metrics));
+                callback(resp);
+            },
+            {Get});
+    }
+
     const auto& translate_to_html = config["translate_to_html"];
     if(!translate_to_html.isNull() && translate_to_html.asBool())
     {
@@ -367,38 +476,43 @@ void GeminiServerPlugin::initAndStart(const Json::Value& config)
 
             if(resp->contentTypeString().find("text/gemini") == 0)
             {
-                auto [body, title] = render2Html(resp->body());
-                if(title.empty())
-                    title = HttpViewData::htmlTranslate(req->path());
-                std::string html = std::string(htmlTemplate);
-                // HACK: Should use a more effectent way to compile HTML
-                drogon::utils::replaceAll(html, "__THIS_IS_THIS_BODY_123456789__", body);
-                drogon::utils::replaceAll(html, "__THIS_IS_THIS_TITLE_123456789__", title);
-                drogon::utils::replaceAll(html, "__THIS_IS_THIS_CSS_123456789__", std::string(cssTemplate));
-                resp->setBody(html);
+                const auto nodes = parseGeminiNodes(resp->body());
+                // The title comes before the body in the page, so find it
+                // the way render2Html() does before rendering
+                const auto heading = std::find_if(nodes.begin(), nodes.end(), [](const GeminiNode& node) {
+                    return node.type == GeminiNodeType::Heading1 && !node.text.empty();
+                });
+                const std::string title = heading != nodes.end() ? HttpViewData::htmlTranslate(std::string(heading->text))
+                                                                 : HttpViewData::htmlTranslate(req->path());
+
+                // The page is written once, straight into its final buffer
+                const auto body_at = htmlTemplate.find(bodyPlaceholder);
+                std::string html;
+                html.reserve(htmlTemplate.size() + cssTemplate.size() + title.size() + resp->body().size() * 2);
+                appendTemplate(html, htmlTemplate.substr(0, body_at), {{titlePlaceholder, title}, {cssPlaceholder, cssTemplate}});
+                StringHtmlSink sink(html);
+                render2Html(nodes, sink);
+                appendTemplate(html, htmlTemplate.substr(body_at + bodyPlaceholder.size()), {});
+                resp->setBody(std::move(html));
                 resp->setContentTypeCode(CT_TEXT_HTML);
             }
             else if(resp->getHeader("gemini-status") != "" && try_stoi(resp->getHeader("gemini-status")).value_or(-1)/10 == 1)
             {
                 bool sensitive_input = req->getHeader("gemini-status") == "11";
-                std::string html = std::string(userInputTemplate);
                 std::string title = HttpViewData::htmlTranslate(resp->getHeader("meta"));
-                // HACK: Should use a more effectent way to compile HTML
-                drogon::utils::replaceAll(html, "__THIS_IS_THIS_TITLE_123456789__", title);
-                drogon::utils::replaceAll(html, "__THIS_IS_THIS_CSS_123456789__", std::string(cssTemplate));
-                drogon::utils::replaceAll(html, "__THIS_IS_TYPE_123456789__", sensitive_input ? "password" : "text");
-                resp->setBody(html);
+                std::string html;
+                appendTemplate(html, userInputTemplate, {{titlePlaceholder, title}, {cssPlaceholder, cssTemplate},
+                                                         {typePlaceholder, sensitive_input ? "password" : "text"}});
+                resp->setBody(std::move(html));
                 resp->setStatusCode(k200OK);
                 resp->setContentTypeCode(CT_TEXT_HTML);
             }
             else if(resp->getHeader("gemini-status") != "" && try_stoi(resp->getHeader("gemini-status")).value_or(-1) == 60)
             {
-                std::string html = std::string(certificateRequiredTemplate);
                 std::string title = HttpViewData::htmlTranslate(resp->getHeader("meta"));
-                // HACK: Should use a more effectent way to compile HTML
-                drogon::utils::replaceAll(html, "__THIS_IS_THIS_TITLE_123456789__", title);
-                drogon::utils::replaceAll(html, "__THIS_IS_THIS_CSS_123456789__", std::string(cssTemplate));
-                resp->setBody(html);
+                std::string html;
+                appendTemplate(html, certificateRequiredTemplate, {{titlePlaceholder, title}, {cssPlaceholder, cssTemplate}});
+                resp->setBody(std::move(html));
                 resp->setStatusCode(k412PreconditionFailed);
                 resp->setContentTypeCode(CT_TEXT_HTML);
             }
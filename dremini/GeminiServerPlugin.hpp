@@ -18,10 +18,19 @@ public:
     GeminiServerPlugin() {}
     void initAndStart(const Json::Value &config) override;
     void shutdown() override;
+    /**
+     * @brief The cache of Gemini responses shared by all listeners, or
+     *        nullptr when "response_cache" is not configured. Handlers call
+     *        invalidate() on it after changing a resource.
+     */
+    std::shared_ptr<ResponseCache> responseCache() const { return responseCache_; }
 
 protected:
     std::shared_ptr<trantor::EventLoopThreadPool> pool_;
     std::vector<std::unique_ptr<GeminiServer>> servers_;
+    // Shared by every listener
+    std::shared_ptr<ServerMetrics> metrics_ = std::make_shared<ServerMetrics>();
+    std::shared_ptr<ResponseCache> responseCache_;
 };
 }
 
@@ -0,0 +1,253 @@
+#include <dremini/GeminiUrl.hpp>
+
+#include <array>
+#include <charconv>
+#include <vector>
+
+namespace dremini
+{
+namespace
+{
+enum CharClass : std::uint8_t
+{
+    kSchemeChar = 1 << 0,
+    kHostChar = 1 << 1,
+    kPathChar = 1 << 2,
+    kQueryChar = 1 << 3,
+    kHexDigit = 1 << 4,
+};
+
+constexpr std::array<std::uint8_t, 256> makeCharClasses()
+{
+    std::array<std::uint8_t, 256> classes{};
+    auto add = [&classes](std::string_view characters, std::uint8_t flags) {
+        for (const auto character : characters)
+            classes[static_cast<unsigned char>(character)] |= flags;
+    };
+    constexpr std::string_view alpha = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    constexpr std::string_view digit = "0123456789";
+    // unreserved and sub-delims from RFC 3986 section 2, plus '%' which is
+    // checked separately for a valid escape.
+    constexpr std::string_view other = "-._~!$&'()*+,;=%";
+    add(alpha, kSchemeChar | kHostChar | kPathChar | kQueryChar);
+    add(digit, kSchemeChar | kHostChar | kPathChar | kQueryChar);
+    add("+-.", kSchemeChar);
+    add(other, kHostChar | kPathChar | kQueryChar);
+    add(":@/", kPathChar | kQueryChar);
+    add("?", kQueryChar);
+    add(digit, kHexDigit);
+    add("abcdefABCDEF", kHexDigit);
+    for (std::size_t byte = 0x80; byte < classes.size(); ++byte)
+        classes[byte] |= kHostChar | kPathChar | kQueryChar;
+    return classes;
+}
+
+constexpr auto kCharClasses = makeCharClasses();
+
+bool is(char character, std::uint8_t flags) noexcept
+{
+    return (kCharClasses[static_cast<unsigned char>(character)] & flags) != 0;
+}
+
+// Checks that every character belongs to `flags` and that each '%' starts a
+// two-digit hex escape.
+bool isValidComponent(std::string_view component, std::uint8_t flags) noexcept
+{
+    for (std::size_t index = 0; index < component.size(); ++index)
+    {
+        const auto character = component[index];
+        if (!is(character, flags)) return false;
+        if (character != '%') continue;
+        if (index + 2 >= component.size() || !is(component[index + 1], kHexDigit) ||
+            !is(component[index + 2], kHexDigit))
+            return false;
+        index += 2;
+    }
+    return true;
+}
+
+bool isValidIpv6Literal(std::string_view host) noexcept
+{
+    if (host.empty()) return false;
+    for (const auto character : host)
+    {
+        if (!is(character, kHexDigit) && character != ':' && character != '.') return false;
+    }
+    return host.find(':') != std::string_view::npos;
+}
+
+// `path` must be absolute.
+std::string removeDotSegments(std::string_view path)
+{
+    std::vector<std::string_view> segments;
+    bool trailingSlash = false;
+    std::size_t begin = 1;
+    while (true)
+    {
+        const auto end = path.find('/', begin);
+        const auto last = end == std::string_view::npos;
+        const auto segment = path.substr(begin, last ? std::string_view::npos : end - begin);
+        trailingSlash = false;
+        if (segment == "..")
+        {
+            if (!segments.empty()) segments.pop_back();
+            trailingSlash = last;
+        }
+        else if (segment == ".")
+        {
+            trailingSlash = last;
+        }
+        else
+        {
+            segments.push_back(segment);
+        }
+        if (last) break;
+        begin = end + 1;
+    }
+
+    std::string result;
+    result.reserve(path.size());
+    for (const auto segment : segments)
+        result.append(1, '/').append(segment);
+    if (result.empty() || trailingSlash) result += '/';
+    return result;
+}
+
+bool parseAuthority(std::string_view authority, GeminiUrl &url) noexcept
+{
+    // Gemini forbids userinfo; refuse it rather than misreading it as a host.
+    if (authority.find('@') != std::string_view::npos) return false;
+
+    std::string_view rest;
+    if (!authority.empty() && authority.front() == '[')
+    {
+        const auto close = authority.find(']');
+        if (close == std::string_view::npos) return false;
+        url.host = authority.substr(1, close - 1);
+        if (!isValidIpv6Literal(url.host)) return false;
+        url.ipv6Host = true;
+        rest = authority.substr(close + 1);
+    }
+    else
+    {
+        const auto colon = authority.find(':');
+        url.host = authority.substr(0, colon);
+        if (url.host.empty() || !isValidComponent(url.host, kHostChar)) return false;
+        rest = colon == std::string_view::npos ? std::string_view{} : authority.substr(colon);
+    }
+
+    if (rest.empty()) return true;
+    if (rest.front() != ':') return false;
+    url.port = rest.substr(1);
+    if (url.port.empty()) return true;
+    unsigned value = 0;
+    const auto end = url.port.data() + url.port.size();
+    const auto result = std::from_chars(url.port.data(), end, value);
+    if (result.ec != std::errc{} || result.ptr != end || value > 65535) return false;
+    url.portNumber = static_cast<std::uint16_t>(value);
+    return true;
+}
+}  // namespace
+
+bool GeminiUrl::hasScheme(std::string_view lowercase) const noexcept
+{
+    if (scheme.size() != lowercase.size()) return false;
+    for (std::size_t index = 0; index < scheme.size(); ++index)
+    {
+        auto character = scheme[index];
+        if (character >= 'A' && character <= 'Z') character = static_cast<char>(character - 'A' + 'a');
+        if (character != lowercase[index]) return false;
+    }
+    return true;
+}
+
+std::optional<GeminiUrl> parseGeminiUrl(std::string_view input) noexcept
+{
+    GeminiUrl url;
+
+    const auto schemeEnd = input.find("://");
+    if (schemeEnd == 0 || schemeEnd == std::string_view::npos) return std::nullopt;
+    url.scheme = input.substr(0, schemeEnd);
+    if (!(url.scheme.front() >= 'a' && url.scheme.front() <= 'z') &&
+        !(url.scheme.front() >= 'A' && url.scheme.front() <= 'Z'))
+        return std::nullopt;
+    for (const auto character : url.scheme)
+        if (!is(character, kSchemeChar)) return std::nullopt;
+
+    auto rest = input.substr(schemeEnd + 3);
+    const auto authorityEnd = rest.find_first_of("/?#");
+    url.authority = rest.substr(0, authorityEnd);
+    if (!parseAuthority(url.authority, url)) return std::nullopt;
+    rest.remove_prefix(url.authority.size());
+
+    const auto pathEnd = rest.find_first_of("?#");
+    url.path = rest.substr(0, pathEnd);
+    if (!isValidComponent(url.path, kPathChar)) return std::nullopt;
+    rest.remove_prefix(url.path.size());
+
+    if (!rest.empty() && rest.front() == '?')
+    {
+        const auto queryEnd = rest.find('#');
+        url.query = rest.substr(1, queryEnd == std::string_view::npos ? queryEnd : queryEnd - 1);
+        url.hasQuery = true;
+        if (!isValidComponent(url.query, kQueryChar)) return std::nullopt;
+        rest.remove_prefix(url.query.size() + 1);
+    }
+    if (!rest.empty())
+    {
+        // Only a fragment can remain here.
+        url.fragment = rest.substr(1);
+        url.hasFragment = true;
+        if (!isValidComponent(url.fragment, kQueryChar)) return std::nullopt;
+    }
+    return url;
+}
+
+std::optional<std::string> resolveGeminiUrl(std::string_view base, std::string_view reference)
+{
+    const auto baseUrl = parseGeminiUrl(base);
+    if (!baseUrl) return std::nullopt;
+    reference = reference.substr(0, reference.find('#'));
+
+    // Absolute references start with a scheme
+    const auto colon = reference.find(':');
+    if (colon != std::string_view::npos && colon < reference.find_first_of("/?"))
+    {
+        if (!parseGeminiUrl(reference)) return std::nullopt;
+        return std::string(reference);
+    }
+
+    std::string resolved(baseUrl->scheme);
+    resolved += "://";
+    if (reference.substr(0, 2) == "//")
+    {
+        resolved.append(reference.substr(2));
+        if (!parseGeminiUrl(resolved)) return std::nullopt;
+        return resolved;
+    }
+    resolved += baseUrl->authority;
+
+    const auto queryStart = reference.find('?');
+    const auto path = reference.substr(0, queryStart);
+    if (path.empty())
+        resolved += baseUrl->path.empty() ? std::string_view("/") : baseUrl->path;
+    else if (path.front() == '/')
+        resolved += removeDotSegments(path);
+    else
+    {
+        // Merge with the base path up to and including its last '/'
+        std::string merged = "/";
+        if (!baseUrl->path.empty()) merged = std::string(baseUrl->path.substr(0, baseUrl->path.rfind('/') + 1));
+        merged += path;
+        resolved += removeDotSegments(merged);
+    }
+
+    if (queryStart != std::string_view::npos)
+        resolved.append(reference.substr(queryStart));
+    else if (path.empty() && baseUrl->hasQuery)
+        resolved.append("?").append(baseUrl->query);
+
+    if (!parseGeminiUrl(resolved)) return std::nullopt;
+    return resolved;
+}
+}  // namespace dremini
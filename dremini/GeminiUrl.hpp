@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace dremini
+{
+// Components of an absolute Gemini/Titan URL (RFC 3986 "scheme://authority
+// path ?query #fragment"). Every view points into the string that was passed
+// to parseGeminiUrl(); the caller must keep that string alive.
+struct GeminiUrl
+{
+    std::string_view scheme;
+    // Host and port exactly as written, e.g. "[::1]:1965".
+    std::string_view authority;
+    // Host without the brackets of an IPv6 literal.
+    std::string_view host;
+    // Digits of the port. Empty when the URL has no port or an empty one.
+    std::string_view port;
+    std::string_view path;
+    std::string_view query;
+    std::string_view fragment;
+    std::uint16_t portNumber = 0;
+    bool hasQuery = false;
+    bool hasFragment = false;
+    bool ipv6Host = false;
+
+    // Schemes are case-insensitive. `lowercase` must already be lowercase.
+    bool hasScheme(std::string_view lowercase) const noexcept;
+    std::uint16_t portOr(std::uint16_t defaultPort) const noexcept
+    {
+        return port.empty() ? defaultPort : portNumber;
+    }
+};
+
+// Parse an absolute URL without allocating. Userinfo is rejected, as Gemini
+// forbids it, and so are characters RFC 3986 never allows in a URI (controls,
+// space, '"', '<', '>', '\\', '^', '`', '{', '|', '}') and malformed
+// percent-encoding. Bytes outside ASCII are accepted so that IRIs sent by
+// some clients keep working.
+std::optional<GeminiUrl> parseGeminiUrl(std::string_view url) noexcept;
+
+// Resolve `reference`, such as the target of a redirect, against the
+// absolute URL `base` (RFC 3986 section 5.2). Dot segments are removed and
+// the fragment is dropped. Returns std::nullopt if either is invalid.
+std::optional<std::string> resolveGeminiUrl(std::string_view base, std::string_view reference);
+}  // namespace dremini
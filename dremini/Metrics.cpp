@@ -0,0 +1,115 @@
+#include <dremini/Metrics.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <string_view>
+
+namespace dremini
+{
+namespace
+{
+void appendNumber(std::string& out, double value)
+{
+    char buffer[32];
+    const auto length = std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    out.append(buffer, static_cast<std::size_t>(length));
+}
+
+void appendCounter(std::string& out, std::string_view name, std::string_view help, std::uint64_t value)
+{
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" counter\n");
+    out.append(name).append(" ").append(std::to_string(value)).append("\n");
+}
+
+void appendHistogram(std::string& out, std::string_view name, std::string_view help, const LatencyHistogram& histogram)
+{
+    const auto snapshot = histogram.snapshot();
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" histogram\n");
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < snapshot.buckets.size(); ++i)
+    {
+        cumulative += snapshot.buckets[i];
+        out.append(name).append("_bucket{le=\"");
+        if (i < LatencyHistogram::kBoundsSeconds.size())
+            appendNumber(out, LatencyHistogram::kBoundsSeconds[i]);
+        else
+            out.append("+Inf");
+        out.append("\"} ").append(std::to_string(cumulative)).append("\n");
+    }
+    out.append(name).append("_sum ");
+    appendNumber(out, snapshot.sumSeconds);
+    out.append("\n");
+    out.append(name).append("_count ").append(std::to_string(snapshot.count)).append("\n");
+}
+}  // namespace
+
+std::size_t metricShard() noexcept
+{
+    static std::atomic<std::size_t> nextShard{0};
+    thread_local const std::size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return shard;
+}
+
+std::uint64_t ShardedCounter::value() const noexcept
+{
+    std::uint64_t total = 0;
+    for (const auto& slot : slots_)
+        total += slot.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+void LatencyHistogram::observe(std::chrono::nanoseconds duration) noexcept
+{
+    const auto nanoseconds = static_cast<std::uint64_t>(std::max(duration.count(), std::chrono::nanoseconds::rep{0}));
+    const auto seconds = static_cast<double>(nanoseconds) / 1e9;
+    const auto bucket = static_cast<std::size_t>(
+        std::lower_bound(kBoundsSeconds.begin(), kBoundsSeconds.end(), seconds) - kBoundsSeconds.begin());
+    auto& slot = slots_[metricShard()];
+    slot.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    slot.sumNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const noexcept
+{
+    Snapshot snapshot;
+    std::uint64_t sumNanoseconds = 0;
+    for (const auto& slot : slots_)
+    {
+        for (std::size_t i = 0; i < slot.buckets.size(); ++i)
+            snapshot.buckets[i] += slot.buckets[i].load(std::memory_order_relaxed);
+        sumNanoseconds += slot.sumNanoseconds.load(std::memory_order_relaxed);
+    }
+    for (const auto count : snapshot.buckets)
+        snapshot.count += count;
+    snapshot.sumSeconds = static_cast<double>(sumNanoseconds) / 1e9;
+    return snapshot;
+}
+
+std::string renderPrometheusText(const ServerMetrics& metrics)
+{
+    std::string out;
+    out.reserve(4096);
+    appendCounter(out, "dremini_connections_accepted_total", "Connections that completed the TLS handshake.",
+                  metrics.connectionsAccepted.value());
+    appendCounter(out, "dremini_handshakes_failed_total", "Connections closed before the TLS handshake completed.",
+                  metrics.handshakesFailed.value());
+
+    out.append("# HELP dremini_responses_total Responses sent, by Gemini status class.\n");
+    out.append("# TYPE dremini_responses_total counter\n");
+    for (std::size_t i = 0; i < metrics.responses.size(); ++i)
+    {
+        out.append("dremini_responses_total{class=\"").append(std::to_string(i + 1)).append("x\"} ");
+        out.append(std::to_string(metrics.responses[i].value())).append("\n");
+    }
+
+    appendCounter(out, "dremini_titan_received_bytes_total", "Titan upload body bytes received.",
+                  metrics.titanBytesReceived.value());
+    appendHistogram(out, "dremini_request_line_parse_seconds", "Time to parse a request line.",
+                    metrics.requestLineParseTime);
+    appendHistogram(out, "dremini_handler_latency_seconds", "Time from dispatching a request to its response.",
+                    metrics.handlerLatency);
+    return out;
+}
+}  // namespace dremini
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dremini
+{
+// Writers update one of several cache-line sized slots, picked per thread,
+// so IO loops counting at once do not contend on a single atomic. Readers
+// add the slots up.
+constexpr std::size_t kMetricShards = 16;
+
+// Slot of the calling thread, fixed for the thread's lifetime.
+std::size_t metricShard() noexcept;
+
+class ShardedCounter
+{
+public:
+    void add(std::uint64_t amount = 1) noexcept
+    {
+        slots_[metricShard()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+    std::uint64_t value() const noexcept;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> value{0};
+    };
+    std::array<Slot, kMetricShards> slots_;
+};
+
+// Durations in fixed buckets, from 10us to 10s.
+class LatencyHistogram
+{
+public:
+    static constexpr std::array<double, 13> kBoundsSeconds{
+        0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10};
+
+    struct Snapshot
+    {
+        // Observations per bucket, not cumulative. The last one is +Inf.
+        std::array<std::uint64_t, kBoundsSeconds.size() + 1> buckets{};
+        std::uint64_t count = 0;
+        double sumSeconds = 0;
+    };
+
+    void observe(std::chrono::nanoseconds duration) noexcept;
+    Snapshot snapshot() const noexcept;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::array<std::atomic<std::uint64_t>, kBoundsSeconds.size() + 1> buckets{};
+        std::atomic<std::uint64_t> sumNanoseconds{0};
+    };
+    std::array<Slot, kMetricShards> slots_;
+};
+
+struct ServerMetrics
+{
+    // Connections that completed the TLS handshake.
+    ShardedCounter connectionsAccepted;
+    ShardedCounter handshakesFailed;
+    // Responses by the first digit of the Gemini status, 1x to 6x.
+    std::array<ShardedCounter, 6> responses;
+    ShardedCounter titanBytesReceived;
+    LatencyHistogram requestLineParseTime;
+    // From handing the request to Drogon until its response comes back.
+    LatencyHistogram handlerLatency;
+};
+
+// Prometheus text exposition format, version 0.0.4.
+std::string renderPrometheusText(const ServerMetrics& metrics);
+}  // namespace dremini
@@ -0,0 +1,108 @@
+#include <dremini/NewlineScanner.hpp>
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DREMINI_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace dremini
+{
+namespace internal
+{
+namespace
+{
+// Continues at `from` until the text ends or the batch is full
+std::size_t scanScalar(const char* data, std::size_t size, std::size_t from, NewlineBatch& batch)
+{
+    std::size_t pos = from;
+    while (pos < size && batch.size < NewlineBatch::kCapacity)
+    {
+        const auto* found = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        if (found == nullptr)
+            return size;
+        batch.offsets[batch.size++] = found - data;
+        pos = found - data + 1;
+    }
+    return pos;
+}
+
+#ifdef DREMINI_X86_SIMD
+// Appends the position of every set bit of `mask`, relative to `base`
+inline void appendMatches(unsigned mask, std::size_t base, NewlineBatch& batch)
+{
+    while (mask != 0)
+    {
+        batch.offsets[batch.size++] = base + __builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+}
+
+// The vector loops only take a block while the batch has room for a match
+// in every byte of it; the scalar tail fills what is left.
+__attribute__((target("sse2"))) std::size_t scanSse2(const char* data, std::size_t size, NewlineBatch& batch)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    std::size_t i = 0;
+    for (; i + 16 <= size && batch.size + 16 <= NewlineBatch::kCapacity; i += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        appendMatches(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline))), i, batch);
+    }
+    return scanScalar(data, size, i, batch);
+}
+
+__attribute__((target("avx2"))) std::size_t scanAvx2(const char* data, std::size_t size, NewlineBatch& batch)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    std::size_t i = 0;
+    for (; i + 32 <= size && batch.size + 32 <= NewlineBatch::kCapacity; i += 32)
+    {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        appendMatches(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline))), i, batch);
+    }
+    return scanScalar(data, size, i, batch);
+}
+#endif
+}  // namespace
+
+const std::vector<NewlineScanKernel>& supportedNewlineScanKernels()
+{
+    static const std::vector<NewlineScanKernel> kernels = []() {
+        std::vector<NewlineScanKernel> supported{NewlineScanKernel::Scalar};
+#ifdef DREMINI_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+            supported.push_back(NewlineScanKernel::SSE2);
+        if (__builtin_cpu_supports("avx2"))
+            supported.push_back(NewlineScanKernel::AVX2);
+#endif
+        return supported;
+    }();
+    return kernels;
+}
+
+std::size_t findNewlines(std::string_view text, NewlineBatch& batch)
+{
+    static const auto best = supportedNewlineScanKernels().back();
+    return findNewlines(text, batch, best);
+}
+
+std::size_t findNewlines(std::string_view text, NewlineBatch& batch, NewlineScanKernel kernel)
+{
+    batch.size = 0;
+    switch (kernel)
+    {
+#ifdef DREMINI_X86_SIMD
+    case NewlineScanKernel::AVX2:
+        return scanAvx2(text.data(), text.size(), batch);
+    case NewlineScanKernel::SSE2:
+        return scanSse2(text.data(), text.size(), batch);
+#endif
+    default:
+        return scanScalar(text.data(), text.size(), 0, batch);
+    }
+}
+}  // namespace internal
+}  // namespace dremini
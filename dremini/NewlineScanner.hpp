@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace dremini
+{
+namespace internal
+{
+enum class NewlineScanKernel
+{
+    // memchr
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Kernels the running CPU supports, fastest last. Scalar is always first.
+const std::vector<NewlineScanKernel>& supportedNewlineScanKernels();
+
+// Offsets of the line breaks found by one findNewlines() call. Callers
+// handle a batch before scanning on, so no scan needs memory proportional to
+// the text.
+struct NewlineBatch
+{
+    static constexpr std::size_t kCapacity = 256;
+    std::array<std::size_t, kCapacity> offsets;
+    std::size_t size = 0;
+};
+
+// Replaces the contents of `batch` with the offsets of the first '\n's in
+// `text`, in order, using the fastest supported kernel. Returns how many
+// bytes were scanned: every '\n' before that offset is in the batch, and the
+// next call should start there.
+std::size_t findNewlines(std::string_view text, NewlineBatch& batch);
+// `kernel` must be one of supportedNewlineScanKernels().
+std::size_t findNewlines(std::string_view text, NewlineBatch& batch, NewlineScanKernel kernel);
+}  // namespace internal
+}  // namespace dremini
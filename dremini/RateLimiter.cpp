@@ -0,0 +1,46 @@
+#include <dremini/RateLimiter.hpp>
+
+#include <algorithm>
+#include <functional>
+
+namespace dremini
+{
+PeerRateLimiter::PeerRateLimiter(double ratePerSecond, double burst)
+    : ratePerSecond_(ratePerSecond), burst_(std::max(burst, 1.0))
+{
+}
+
+double PeerRateLimiter::acquire(std::string_view peer, Clock::time_point now)
+{
+    auto &shard = shards_[std::hash<std::string_view>{}(peer) % kShardCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto found = shard.index.find(peer);
+    if (found != shard.index.end())
+    {
+        shard.buckets.splice(shard.buckets.begin(), shard.buckets, found->second);
+    }
+    else
+    {
+        // The least recently seen peer has been idle the longest, so its
+        // bucket is the one most likely to have refilled anyway.
+        if (shard.buckets.size() >= kMaxBucketsPerShard)
+        {
+            shard.index.erase(shard.buckets.back().peer);
+            shard.buckets.pop_back();
+        }
+        shard.buckets.push_front(Bucket{std::string(peer), burst_, now});
+        shard.index.emplace(shard.buckets.front().peer, shard.buckets.begin());
+    }
+
+    auto &bucket = shard.buckets.front();
+    const std::chrono::duration<double> elapsed = now - bucket.updated;
+    bucket.tokens = std::min(burst_, bucket.tokens + std::max(elapsed.count(), 0.0) * ratePerSecond_);
+    bucket.updated = now;
+    if (bucket.tokens >= 1.0)
+    {
+        bucket.tokens -= 1.0;
+        return 0;
+    }
+    return (1.0 - bucket.tokens) / ratePerSecond_;
+}
+}  // namespace dremini
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace dremini
+{
+// Token bucket per peer. Buckets are spread over independently locked shards
+// by a hash of the peer, so IO loops admitting different peers rarely touch
+// the same lock.
+class PeerRateLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // `ratePerSecond` tokens are added per second, up to `burst` tokens.
+    PeerRateLimiter(double ratePerSecond, double burst);
+
+    // Takes one token for `peer`. Returns 0 on success, otherwise the number
+    // of seconds until a token becomes available.
+    double acquire(std::string_view peer, Clock::time_point now = Clock::now());
+
+private:
+    static constexpr std::size_t kShardCount = 64;
+    // Past this size, the least recently seen peer's bucket is dropped.
+    static constexpr std::size_t kMaxBucketsPerShard = 4096;
+
+    struct Bucket
+    {
+        std::string peer;
+        double tokens;
+        Clock::time_point updated;
+    };
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        // Most recently seen first. List nodes never move, so the index can
+        // point into their peers.
+        std::list<Bucket> buckets;
+        std::unordered_map<std::string_view, std::list<Bucket>::iterator> index;
+    };
+
+    double ratePerSecond_;
+    double burst_;
+    std::array<Shard, kShardCount> shards_;
+};
+}  // namespace dremini
@@ -0,0 +1,108 @@
+#include <dremini/ResponseCache.hpp>
+
+#include <functional>
+#include <iterator>
+
+namespace dremini
+{
+ResponseCache::ResponseCache(std::size_t maxBytes) : maxShardBytes_(maxBytes / kShardCount)
+{
+}
+
+std::string ResponseCache::makeKey(std::string_view authority, std::string_view path, std::string_view query)
+{
+    std::string key;
+    key.reserve(path.size() + authority.size() + query.size() + 2);
+    key.append(path).append(1, '\n').append(authority).append(1, '\n').append(query);
+    return key;
+}
+
+ResponseCache::Shard &ResponseCache::shardFor(std::string_view path)
+{
+    return shards_[std::hash<std::string_view>{}(path) % kShardCount];
+}
+
+void ResponseCache::erase(Shard &shard, std::list<Entry>::iterator entry)
+{
+    shard.bytes -= entry->key.size() + entry->response->size();
+    shard.index.erase(entry->key);
+    shard.entries.erase(entry);
+}
+
+std::shared_ptr<const std::string> ResponseCache::find(std::string_view authority,
+                                                       std::string_view path,
+                                                       std::string_view query,
+                                                       Clock::time_point now)
+{
+    const auto key = makeKey(authority, path, query);
+    auto &shard = shardFor(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) return nullptr;
+    if (it->second->expires <= now)
+    {
+        erase(shard, it->second);
+        return nullptr;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->response;
+}
+
+void ResponseCache::insert(std::string_view authority,
+                           std::string_view path,
+                           std::string_view query,
+                           std::shared_ptr<const std::string> response,
+                           std::chrono::seconds ttl,
+                           Clock::time_point now)
+{
+    auto key = makeKey(authority, path, query);
+    const auto bytes = key.size() + response->size();
+    if (ttl.count() <= 0 || bytes > maxShardBytes_) return;
+
+    auto &shard = shardFor(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto existing = shard.index.find(key);
+    if (existing != shard.index.end()) erase(shard, existing->second);
+    while (shard.bytes + bytes > maxShardBytes_ && !shard.entries.empty())
+        erase(shard, std::prev(shard.entries.end()));
+
+    shard.entries.push_front(Entry{std::move(key), std::move(response), now + ttl});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.bytes += bytes;
+}
+
+void ResponseCache::invalidate(std::string_view path)
+{
+    auto &shard = shardFor(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto it = shard.entries.begin(); it != shard.entries.end();)
+    {
+        const auto current = it++;
+        const std::string_view key = current->key;
+        if (key.size() > path.size() && key[path.size()] == '\n' && key.compare(0, path.size(), path) == 0)
+            erase(shard, current);
+    }
+}
+
+void ResponseCache::clear()
+{
+    for (auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+        shard.bytes = 0;
+    }
+}
+
+std::size_t ResponseCache::sizeBytes() const
+{
+    std::size_t total = 0;
+    for (const auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.bytes;
+    }
+    return total;
+}
+}  // namespace dremini
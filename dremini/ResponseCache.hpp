@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace dremini
+{
+// A handler opts a Gemini response into the cache by setting this header to
+// the number of seconds the response stays valid.
+inline constexpr char kGeminiCacheTtlHeader[] = "gemini-cache-ttl";
+
+// Complete Gemini responses, status line and body, keyed by authority, path
+// and query. Entries are spread over independently locked shards by path and
+// evicted least recently used first once the shard is over its share of the
+// byte budget.
+class ResponseCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ResponseCache(std::size_t maxBytes);
+
+    // Returns nullptr on a miss or when the entry has expired.
+    std::shared_ptr<const std::string> find(std::string_view authority,
+                                            std::string_view path,
+                                            std::string_view query,
+                                            Clock::time_point now = Clock::now());
+    // Responses bigger than a shard's budget are not stored.
+    void insert(std::string_view authority,
+                std::string_view path,
+                std::string_view query,
+                std::shared_ptr<const std::string> response,
+                std::chrono::seconds ttl,
+                Clock::time_point now = Clock::now());
+    // Drops every entry for `path`, whatever its authority and query.
+    void invalidate(std::string_view path);
+    void clear();
+    std::size_t sizeBytes() const;
+
+private:
+    static constexpr std::size_t kShardCount = 16;
+
+    struct Entry
+    {
+        // path '\n' authority '\n' query; no URL contains a raw newline.
+        std::string key;
+        std::shared_ptr<const std::string> response;
+        Clock::time_point expires;
+    };
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        // Most recently used first. List nodes never move, so the index can
+        // point into their keys.
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        std::size_t bytes = 0;
+    };
+
+    static std::string makeKey(std::string_view authority, std::string_view path, std::string_view query);
+    Shard &shardFor(std::string_view path);
+    static void erase(Shard &shard, std::list<Entry>::iterator entry);
+
+    std::size_t maxShardBytes_;
+    std::array<Shard, kShardCount> shards_;
+};
+}  // namespace dremini
@@ -2,9 +2,13 @@
 
 #include <drogon/HttpAppFramework.h>
 #include <drogon/utils/Utilities.h>
+#include <trantor/utils/SerialTaskQueue.h>
 
+#include <atomic>
 #include <charconv>
 #include <cctype>
+#include <filesystem>
+#include <fstream>
 #include <limits>
 #include <map>
 #include <mutex>
@@ -37,6 +41,165 @@ std::optional<std::string> decodeParameter(std::string_view value)
     return decoded;
 }
 
+class MemorySink : public TitanUploadSink
+{
+public:
+    bool write(std::string_view chunk) override
+    {
+        // The declared size is peer-controlled. Do not reserve it: memory is
+        // acquired only for bytes actually received.
+        body_.append(chunk);
+        return true;
+    }
+    bool finish(drogon::HttpRequest &request) override
+    {
+        request.setBody(std::move(body_));
+        return true;
+    }
+
+private:
+    std::string body_;
+};
+
+// All file sinks write on this one thread, in order. Never destroyed, so
+// writes queued during shutdown do not outlive it.
+trantor::SerialTaskQueue &spoolQueue()
+{
+    static auto *queue = new trantor::SerialTaskQueue("TitanSpool");
+    return *queue;
+}
+
+// Above this many queued bytes a FileSink is congested, and it stays so
+// until the spool thread has written them down to a quarter of it.
+constexpr std::size_t kMaxQueuedSpoolBytes = 1024 * 1024;
+
+class FileSink : public TitanUploadSink
+{
+public:
+    explicit FileSink(const std::string &directory) : spool_(std::make_shared<Spool>())
+    {
+        spool_->path = (std::filesystem::path(directory) / ("titan-" + drogon::utils::getUuid())).string();
+        spoolQueue().runTaskInQueue([spool = spool_, directory]() {
+            std::error_code error;
+            std::filesystem::create_directories(directory, error);
+            spool->file.open(spool->path, std::ios::binary | std::ios::trunc);
+            if (!spool->file)
+            {
+                LOG_ERROR << "Cannot create Titan upload file " << spool->path;
+                spool->failed = true;
+            }
+        });
+    }
+    ~FileSink() override
+    {
+        // Only reached without finishing when the upload was abandoned
+        if (!finished_)
+            spoolQueue().runTaskInQueue([spool = spool_]() { spool->discard(); });
+    }
+    bool write(std::string_view chunk) override
+    {
+        if (spool_->failed) return false;
+        size_ += chunk.size();
+        {
+            std::lock_guard<std::mutex> lock(spool_->mutex);
+            spool_->queuedBytes += chunk.size();
+        }
+        spoolQueue().runTaskInQueue([spool = spool_, data = std::string(chunk)]() {
+            if (!spool->failed)
+            {
+                spool->file.write(data.data(), static_cast<std::streamsize>(data.size()));
+                if (!spool->file) spool->failed = true;
+            }
+            std::function<void()> drained;
+            {
+                std::lock_guard<std::mutex> lock(spool->mutex);
+                spool->queuedBytes -= data.size();
+                if (spool->queuedBytes <= kMaxQueuedSpoolBytes / 4) drained = std::move(spool->drained);
+            }
+            if (drained) drained();
+        });
+        return true;
+    }
+    bool congested() const override
+    {
+        std::lock_guard<std::mutex> lock(spool_->mutex);
+        return spool_->queuedBytes > kMaxQueuedSpoolBytes;
+    }
+    void whenDrained(std::function<void()> callback) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(spool_->mutex);
+            if (spool_->queuedBytes > kMaxQueuedSpoolBytes / 4)
+            {
+                spool_->drained = std::move(callback);
+                return;
+            }
+        }
+        callback();
+    }
+    bool finish(drogon::HttpRequest &request) override
+    {
+        finished_ = true;
+        bool closed = false;
+        spoolQueue().syncTaskInQueue([this, &closed]() { closed = spool_->close(); });
+        return attach(request, closed);
+    }
+    void finishAsync(drogon::HttpRequest &request, std::function<void(bool)> done) override
+    {
+        finished_ = true;
+        spoolQueue().runTaskInQueue(
+            [spool = spool_, size = size_, target = &request, done = std::move(done)]() {
+                done(attach(*target, spool->close(), spool->path, size));
+            });
+    }
+
+private:
+    // Shared with the queued writes, which may outlive the sink
+    struct Spool
+    {
+        std::string path;
+        std::ofstream file;
+        std::atomic<bool> failed{false};
+        std::mutex mutex;
+        std::size_t queuedBytes = 0;
+        std::function<void()> drained;
+
+        // Runs on the spool thread after every write. Removes the file
+        // unless all of it was written.
+        bool close()
+        {
+            file.close();
+            if (failed || !file)
+            {
+                discard();
+                return false;
+            }
+            return true;
+        }
+        void discard()
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(path, error);
+        }
+    };
+
+    bool attach(drogon::HttpRequest &request, bool closed) const
+    {
+        return attach(request, closed, spool_->path, size_);
+    }
+    static bool attach(drogon::HttpRequest &request, bool closed, const std::string &path, std::size_t size)
+    {
+        if (!closed) return false;
+        request.getAttributes()->insert(kTitanUploadFileAttribute, std::make_shared<TitanUploadFile>(path, size));
+        return true;
+    }
+
+    std::shared_ptr<Spool> spool_;
+    std::size_t size_ = 0;
+    bool finished_ = false;
+};
+
 TitanParseResult failure(TitanParseError error)
 {
     return {{}, error};
@@ -87,6 +250,33 @@ std::optional<std::map<std::string, std::string>> parseParameters(
 }
 }  // namespace
 
+TitanUploadFile::~TitanUploadFile()
+{
+    if (saved_) return;
+    std::error_code error;
+    std::filesystem::remove(path_, error);
+}
+
+bool TitanUploadFile::saveAs(const std::string &destination)
+{
+    std::error_code error;
+    std::filesystem::rename(path_, destination, error);
+    if (error) return false;
+    path_ = destination;
+    saved_ = true;
+    return true;
+}
+
+std::unique_ptr<TitanUploadSink> newTitanMemorySink()
+{
+    return std::make_unique<MemorySink>();
+}
+
+std::unique_ptr<TitanUploadSink> newTitanFileSink(const std::string &directory)
+{
+    return std::make_unique<FileSink>(directory);
+}
+
 TitanParseResult parseTitanRequest(std::string_view path, std::size_t maxUploadBytes)
 {
     const auto parameters = path.find(';');
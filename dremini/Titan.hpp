@@ -1,13 +1,23 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
 
+namespace drogon
+{
+class HttpRequest;
+}
+
 namespace dremini
 {
 inline constexpr char kTitanEditRequestAttribute[] = "dremini.titan.edit";
+// Holds a std::shared_ptr<TitanUploadFile> when an upload was spooled to disk
+// instead of being stored in the request body.
+inline constexpr char kTitanUploadFileAttribute[] = "dremini.titan.upload_file";
 // The parsed authority comes from the Gemini/Titan request line, rather than
 // an HTTP header supplied by a translator client.
 inline constexpr char kRequestAuthorityAttribute[] = "dremini.request_authority";
@@ -43,6 +53,62 @@ struct TitanParseResult
     explicit operator bool() const noexcept { return request.has_value(); }
 };
 
+// Receives a Titan upload body as it arrives from the network. write() is
+// called for each chunk in order, then finish() once all declared bytes have
+// arrived, before the request is dispatched. Returning false from either
+// rejects the upload with a temporary failure.
+//
+// Sinks doing blocking I/O should do it off the connection's loop. They
+// report congested() while too much is queued, and the server stops reading
+// from the connection until the callback given to whenDrained() runs. The
+// server finishes uploads through finishAsync(), which keeps `request` alive
+// until `done` is called. Both callbacks may be called on any thread.
+class TitanUploadSink
+{
+public:
+    virtual ~TitanUploadSink() = default;
+    virtual bool write(std::string_view chunk) = 0;
+    virtual bool finish(drogon::HttpRequest &request) = 0;
+    virtual void finishAsync(drogon::HttpRequest &request, std::function<void(bool)> done)
+    {
+        done(finish(request));
+    }
+    virtual bool congested() const { return false; }
+    virtual void whenDrained(std::function<void()> callback) { callback(); }
+};
+
+using TitanUploadSinkFactory = std::function<std::unique_ptr<TitanUploadSink>(const TitanRequest &request)>;
+
+// A spooled upload. The file is removed when the last reference goes away
+// unless the handler moved it elsewhere with saveAs().
+class TitanUploadFile
+{
+public:
+    TitanUploadFile(std::string path, std::size_t size) : path_(std::move(path)), size_(size) {}
+    ~TitanUploadFile();
+    TitanUploadFile(const TitanUploadFile &) = delete;
+    TitanUploadFile &operator=(const TitanUploadFile &) = delete;
+
+    const std::string &path() const noexcept { return path_; }
+    std::size_t size() const noexcept { return size_; }
+    // Move the file to `destination`. Returns false if it could not be moved.
+    bool saveAs(const std::string &destination);
+
+private:
+    std::string path_;
+    std::size_t size_;
+    bool saved_ = false;
+};
+
+// Collects the body in memory and sets it as the request body. This is the
+// default and keeps handlers reading req->body().
+std::unique_ptr<TitanUploadSink> newTitanMemorySink();
+// Streams the body into a file under `directory` and attaches it to the
+// request as kTitanUploadFileAttribute, leaving the request body empty. The
+// file is written on a background thread shared by all file sinks, so a slow
+// disk does not stall the connections of an IO loop.
+std::unique_ptr<TitanUploadSink> newTitanFileSink(const std::string &directory);
+
 // Parse Titan's semicolon-delimited parameters from an already-separated URI
 // path. The query is deliberately not part of this input: Titan parameters
 // are a semicolon-delimited suffix before '?'.
@@ -0,0 +1,178 @@
+#include <dremini/TofuStore.hpp>
+#include <trantor/utils/Logger.h>
+#include <trantor/utils/SerialTaskQueue.h>
+
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+namespace dremini
+{
+namespace
+{
+// Records are lines of "<endpoint> <fingerprint> <expiry in unix seconds>".
+// A fingerprint of "-" forgets the endpoint. Later records win.
+void formatRecord(std::string& out, const std::string& endpoint, const TofuPin* pin)
+{
+    out += endpoint;
+    if (pin)
+    {
+        out += ' ';
+        out += pin->fingerprint;
+        out += ' ';
+        out += std::to_string(std::chrono::duration_cast<std::chrono::seconds>(pin->expires.time_since_epoch()).count());
+    }
+    else
+    {
+        out += " - 0";
+    }
+    out += '\n';
+}
+}  // namespace
+
+TofuStore::TofuStore(std::string path, TofuOptions options) : path_(std::move(path)), options_(std::move(options))
+{
+    if (path_.empty())
+        return;
+    load();
+    writer_ = std::make_unique<trantor::SerialTaskQueue>("TofuStore");
+}
+
+TofuStore::~TofuStore()
+{
+    flush();
+}
+
+void TofuStore::load()
+{
+    std::ifstream in(path_);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string endpoint, fingerprint;
+        long long expires = 0;
+        if (!(fields >> endpoint >> fingerprint >> expires))
+        {
+            LOG_WARN << "Ignoring malformed record in " << path_;
+            continue;
+        }
+        records_++;
+        if (fingerprint == "-")
+            pins_.erase(endpoint);
+        else
+            pins_[endpoint] = TofuPin{fingerprint, Clock::time_point(std::chrono::seconds(expires))};
+    }
+}
+
+ServerTrust TofuStore::trust()
+{
+    return [self = shared_from_this()](std::string endpoint, trantor::CertificatePtr certificate,
+                                       ServerTrustDecision decide) {
+        decide(certificate && self->check(endpoint, certificate->sha256Fingerprint()) != Verdict::Mismatch);
+    };
+}
+
+TofuStore::Verdict TofuStore::check(const std::string& endpoint, const std::string& fingerprint, Clock::time_point now)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        const auto pin = pins_.find(endpoint);
+        if (pin != pins_.end() && pin->second.expires > now)
+            return pin->second.fingerprint == fingerprint ? Verdict::Matched : Verdict::Mismatch;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // Another thread may have pinned the endpoint in the meantime
+    const auto pin = pins_.find(endpoint);
+    if (pin != pins_.end() && pin->second.expires > now)
+        return pin->second.fingerprint == fingerprint ? Verdict::Matched : Verdict::Mismatch;
+    store(endpoint, TofuPin{fingerprint, now + options_.pinLifetime});
+    return Verdict::Pinned;
+}
+
+void TofuStore::pin(const std::string& endpoint, const std::string& fingerprint, Clock::time_point now)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    store(endpoint, TofuPin{fingerprint, now + options_.pinLifetime});
+}
+
+void TofuStore::forget(const std::string& endpoint)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (pins_.erase(endpoint) != 0)
+        append(endpoint, nullptr);
+}
+
+std::optional<TofuPin> TofuStore::find(const std::string& endpoint) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const auto pin = pins_.find(endpoint);
+    if (pin == pins_.end())
+        return std::nullopt;
+    return pin->second;
+}
+
+std::size_t TofuStore::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return pins_.size();
+}
+
+void TofuStore::flush()
+{
+    if (writer_)
+        writer_->waitAllTasksFinished();
+}
+
+void TofuStore::store(const std::string& endpoint, TofuPin pin)
+{
+    auto& stored = pins_[endpoint];
+    stored = std::move(pin);
+    append(endpoint, &stored);
+}
+
+void TofuStore::append(const std::string& endpoint, const TofuPin* pin)
+{
+    if (!writer_)
+        return;
+
+    if (records_ < pins_.size() + options_.compactAfter)
+    {
+        records_++;
+        std::string record;
+        formatRecord(record, endpoint, pin);
+        writer_->runTaskInQueue([this, record = std::move(record)]() {
+            if (!file_.is_open())
+                file_.open(path_, std::ios::app);
+            file_ << record << std::flush;
+            if (!file_)
+                LOG_ERROR << "Failed to write to " << path_;
+        });
+        return;
+    }
+
+    // Rewrite the file with the live pins, then atomically replace it.
+    // Records queued after this one land in the new file.
+    records_ = pins_.size();
+    std::string contents;
+    for (const auto& [name, live] : pins_)
+        formatRecord(contents, name, &live);
+    writer_->runTaskInQueue([this, contents = std::move(contents)]() {
+        file_.close();
+        const auto temporary = path_ + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            out << contents << std::flush;
+            if (!out)
+            {
+                LOG_ERROR << "Failed to compact " << path_;
+                return;
+            }
+        }
+        if (std::rename(temporary.c_str(), path_.c_str()) != 0)
+            LOG_ERROR << "Failed to replace " << path_;
+    });
+}
+}  // namespace dremini
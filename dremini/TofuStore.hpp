@@ -0,0 +1,93 @@
+#pragma once
+
+#include <dremini/GeminiClient.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace trantor
+{
+class SerialTaskQueue;
+}
+
+namespace dremini
+{
+struct TofuOptions
+{
+    // How long a pinned fingerprint is trusted. Once it expires, the next
+    // certificate seen for the endpoint is pinned in its place.
+    std::chrono::seconds pinLifetime{std::chrono::hours(24 * 365)};
+    // The file is rewritten with only the live pins once it holds this many
+    // records more than there are pins.
+    std::size_t compactAfter = 1024;
+};
+
+struct TofuPin
+{
+    std::string fingerprint;
+    std::chrono::system_clock::time_point expires;
+};
+
+// Trust-on-first-use certificate store. The first certificate seen for an
+// endpoint is pinned; later connections are only trusted with the same
+// certificate until the pin expires. Lookups are served from memory and
+// never wait for the disk, so the store can be used on any event loop.
+class TofuStore : public std::enable_shared_from_this<TofuStore>
+{
+public:
+    using Clock = std::chrono::system_clock;
+    enum class Verdict
+    {
+        // First use, or the old pin had expired; the fingerprint is now pinned
+        Pinned,
+        Matched,
+        Mismatch
+    };
+
+    // Loads the pins in `path`, creating it on the first write. With an empty
+    // path the pins are kept in memory only.
+    explicit TofuStore(std::string path = "", TofuOptions options = {});
+    ~TofuStore();
+    TofuStore(const TofuStore&) = delete;
+    TofuStore& operator=(const TofuStore&) = delete;
+
+    // ServerTrust that checks certificates against the store. Keeps the
+    // store alive.
+    ServerTrust trust();
+
+    Verdict check(const std::string& endpoint, const std::string& fingerprint, Clock::time_point now = Clock::now());
+    // Pins `fingerprint` unconditionally, e.g. after the user accepted a
+    // changed certificate.
+    void pin(const std::string& endpoint, const std::string& fingerprint, Clock::time_point now = Clock::now());
+    void forget(const std::string& endpoint);
+    std::optional<TofuPin> find(const std::string& endpoint) const;
+    std::size_t size() const;
+
+    // Blocks until every change so far has reached the file.
+    void flush();
+
+private:
+    void load();
+    // Expects mutex_ held exclusively, so records reach the file in the
+    // order the index changed.
+    void append(const std::string& endpoint, const TofuPin* pin);
+    void store(const std::string& endpoint, TofuPin pin);
+
+    const std::string path_;
+    const TofuOptions options_;
+    std::unique_ptr<trantor::SerialTaskQueue> writer_;
+    // Only used on writer_
+    std::ofstream file_;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, TofuPin> pins_;
+    // Records in the file, live or superseded
+    std::size_t records_ = 0;
+};
+}  // namespace dremini
@@ -0,0 +1,98 @@
+// Client requests/sec against the number of event loops issuing them. Start
+// test_server first, then:
+//
+//   client_loops_bench [requests per loop] [concurrency per loop] [max loops]
+//
+// Loop counts double from 1 up to the maximum. Requests on different loops
+// share no client-side state but the GeminiClientContext, so throughput
+// should grow with the loop count until test_server saturates.
+#include <dremini/GeminiClient.hpp>
+#include <drogon/drogon.h>
+#include <trantor/net/EventLoopThreadPool.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace drogon;
+
+namespace
+{
+const std::string kUrl = "gemini://127.0.0.1/apitest";
+
+struct LoopRun
+{
+    trantor::EventLoop* loop;
+    std::size_t requests;
+    std::size_t issued = 0;
+    std::size_t completed = 0;
+    std::atomic<std::size_t>* failed;
+    std::function<void()> finished;
+};
+
+// Only touched on its own loop, so no synchronisation is needed.
+void issue(const std::shared_ptr<LoopRun>& run, const std::shared_ptr<dremini::GeminiClientContext>& context)
+{
+    if (run->issued == run->requests)
+        return;
+    run->issued++;
+    dremini::sendRequest(kUrl, [run, context](ReqResult result, const HttpResponsePtr&) {
+        if (result != ReqResult::Ok)
+            run->failed->fetch_add(1, std::memory_order_relaxed);
+        if (++run->completed == run->requests)
+            run->finished();
+        else
+            issue(run, context);
+    }, 10, run->loop, -1, {}, 0, dremini::kNoVerification, context);
+}
+
+void measure(std::size_t loops, std::size_t requestsPerLoop, std::size_t concurrency)
+{
+    trantor::EventLoopThreadPool pool(loops, "ClientBenchLoop");
+    pool.start();
+    const auto context = std::make_shared<dremini::GeminiClientContext>();
+    std::atomic<std::size_t> failed{0};
+    std::atomic<std::size_t> remainingLoops{loops};
+    std::promise<void> done;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto loop : pool.getLoops())
+    {
+        auto run = std::make_shared<LoopRun>();
+        run->loop = loop;
+        run->requests = requestsPerLoop;
+        run->failed = &failed;
+        run->finished = [&remainingLoops, &done]() {
+            if (remainingLoops.fetch_sub(1) == 1)
+                done.set_value();
+        };
+        loop->queueInLoop([run, context, concurrency]() {
+            for (std::size_t i = 0; i < concurrency; i++)
+                issue(run, context);
+        });
+    }
+    done.get_future().wait();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto total = loops * requestsPerLoop;
+    std::printf("%2zu loops: %10.1f req/s  (%zu requests, %zu failed)\n",
+                loops, total / elapsed.count(), total, failed.load());
+    for (auto loop : pool.getLoops())
+        loop->quit();
+    pool.wait();
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const std::size_t requests = argc > 1 ? std::stoul(argv[1]) : 2000;
+    const std::size_t concurrency = argc > 2 ? std::stoul(argv[2]) : 8;
+    const std::size_t maxLoops = argc > 3 ? std::stoul(argv[3]) : 16;
+
+    for (std::size_t loops = 1; loops <= maxLoops; loops *= 2)
+        measure(loops, requests, concurrency);
+}
@@ -0,0 +1,77 @@
+// Parses a large synthetic gemlog index with parseGemini, which copies every
+// field into std::strings, and with parseGeminiNodes, which only produces
+// views. Reports megabytes of gemtext parsed per second on one core, and how
+// fast each newline scanning kernel the CPU supports gets through the same text.
+#include <dremini/GeminiParser.hpp>
+#include <dremini/NewlineScanner.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dremini;
+
+static std::string makeCorpus(std::size_t entries)
+{
+    std::string corpus = "# A gemlog\n\nWelcome to my capsule. Entries are listed newest first.\n\n";
+    for (std::size_t i = 0; i < entries; ++i)
+    {
+        if (i % 50 == 0)
+            corpus += "## Entries from volume " + std::to_string(i / 50) + "\n\n";
+        corpus += "=> /gemlog/" + std::to_string(i) + "-a-post-about-something.gmi 2022-01-01 - A post about something #" +
+                  std::to_string(i) + "\n";
+        if (i % 10 == 0)
+            corpus += "* tagged: gemini, c++, networking\n> A quote that was worth keeping around for later\n";
+        if (i % 100 == 0)
+            corpus += "```ascii art\n  /\\_/\\\n ( o.o )\n  > ^ <\n```\n";
+    }
+    return corpus;
+}
+
+template <typename Function>
+static double megabytesPerSecond(const std::string& corpus, std::size_t rounds, Function&& parse)
+{
+    std::size_t nodes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t round = 0; round < rounds; ++round)
+        nodes += parse(corpus);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (nodes == 0)
+        std::fprintf(stderr, "warning: nothing parsed\n");
+    return static_cast<double>(corpus.size() * rounds) / elapsed.count() / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 50;
+    const auto corpus = makeCorpus(100000);
+
+    const auto copying = megabytesPerSecond(corpus, rounds, [](const std::string& source) {
+        return parseGemini(source).size();
+    });
+    const auto views = megabytesPerSecond(corpus, rounds, [](const std::string& source) {
+        return parseGeminiNodes(source).size();
+    });
+
+    std::printf("corpus           : %12.1f MB\n", corpus.size() / 1e6);
+    std::printf("parseGemini      : %12.1f MB/s\n", copying);
+    std::printf("parseGeminiNodes : %12.1f MB/s\n", views);
+    std::printf("speedup          : %12.1fx\n", views / copying);
+
+    static const char* const kernelNames[] = {"scalar", "sse2", "avx2"};
+    internal::NewlineBatch newlines;
+    for (const auto kernel : internal::supportedNewlineScanKernels())
+    {
+        const auto scanned = megabytesPerSecond(corpus, rounds, [&](const std::string& source) {
+            std::size_t found = 0;
+            for (std::size_t pos = 0; pos < source.size();)
+            {
+                pos += internal::findNewlines(std::string_view(source).substr(pos), newlines, kernel);
+                found += newlines.size;
+            }
+            return found;
+        });
+        std::printf("findNewlines %-6s: %10.1f MB/s\n", kernelNames[static_cast<int>(kernel)], scanned);
+    }
+}
@@ -0,0 +1,111 @@
+// Renders a gemlog-style document to HTML through each render2Html() API and
+// reports megabytes of gemtext rendered per second and heap allocations per
+// document, counted by replacing the global operator new.
+#include <dremini/GeminiRenderer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace dremini;
+
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+static std::string makeDocument(std::size_t entries)
+{
+    std::string document = "# A gemlog & its <entries>\n\nWelcome to my capsule. Entries are listed newest first.\n\n";
+    for (std::size_t i = 0; i < entries; ++i)
+    {
+        if (i % 50 == 0)
+            document += "## Entries from volume " + std::to_string(i / 50) + "\n\n";
+        document += "=> /gemlog/" + std::to_string(i) + ".gmi 2022-01-01 - A post about \"something\" #" +
+                    std::to_string(i) + "\n";
+        if (i % 10 == 0)
+            document += "Some prose about the post, with a *little* emphasis.\n* tagged: gemini, c++\n> A quote\n";
+        if (i % 100 == 0)
+            document += "```cpp\nint main() { return 0 < 1; }\n```\n";
+    }
+    return document;
+}
+
+struct Result
+{
+    double megabytesPerSecond;
+    double allocationsPerDocument;
+};
+
+template <typename Function>
+static Result measure(const std::string& document, std::size_t rounds, Function&& render)
+{
+    std::size_t bytes = 0;
+    const auto allocationsBefore = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t round = 0; round < rounds; ++round)
+        bytes += render();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const auto allocated = allocations.load() - allocationsBefore;
+    if (bytes == 0)
+        std::fprintf(stderr, "warning: nothing rendered\n");
+    return {static_cast<double>(document.size() * rounds) / elapsed.count() / 1e6,
+            static_cast<double>(allocated) / rounds};
+}
+
+static void report(const char* name, const Result& result)
+{
+    std::printf("%-28s: %10.1f MB/s %12.1f allocations/document\n", name, result.megabytesPerSecond,
+                result.allocationsPerDocument);
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 200;
+    const auto document = makeDocument(2000);
+    const auto nodes = parseGeminiNodes(document);
+    std::printf("document                    : %10.1f kB, %zu nodes\n", document.size() / 1e3, nodes.size());
+
+    for (const bool extended : {false, true})
+    {
+        std::printf("%s mode\n", extended ? "extended" : "standard");
+        report("render2Html -> pair", measure(document, rounds, [&]() {
+                   return render2Html(nodes, extended).first.size();
+               }));
+
+        // A page buffer reused across requests keeps its capacity
+        std::string page;
+        report("render2Html -> string sink", measure(document, rounds, [&]() {
+                   page.clear();
+                   StringHtmlSink sink(page);
+                   render2Html(nodes, sink, extended);
+                   return page.size();
+               }));
+
+        std::size_t streamed = 0;
+        ChunkedHtmlSink chunked([&streamed](std::string_view chunk) { streamed += chunk.size(); });
+        report("render2Html -> chunked sink", measure(document, rounds, [&]() {
+                   streamed = 0;
+                   render2Html(nodes, chunked, extended);
+                   return streamed;
+               }));
+    }
+}
@@ -0,0 +1,89 @@
+// Parses and renders gemtext dominated by multi-megabyte preformatted blocks
+// (ASCII art, source listings and a Markdown block that is not a table).
+// Block content is a slice of the source, so parsing should run close to the
+// speed of finding newlines. For comparison it also times rebuilding the same
+// content line by line through std::getline, as parseGemini used to.
+#include <dremini/GeminiParser.hpp>
+#include <dremini/GeminiRenderer.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+using namespace dremini;
+
+static std::string makeBlock(std::string_view meta, std::string_view line, std::size_t bytes)
+{
+    std::string block = "```" + std::string(meta) + "\n";
+    while (block.size() < bytes)
+        block.append(line).append("\n");
+    return block + "```\n";
+}
+
+static std::string makeCorpus(std::size_t blockBytes)
+{
+    std::string corpus = "# A post with large listings\n\nSome text before the art.\n";
+    corpus += makeBlock("ascii art", "  /\\_/\\    ( o.o )    > ^ <    /\\_/\\    ( o.o )    > ^ <", blockBytes);
+    corpus += "Followed by the source:\n";
+    corpus += makeBlock("cpp", "    for (const auto& node : nodes) total += node.text.size(); // sum", blockBytes);
+    corpus += makeBlock("md", "Not a table, just *Markdown* prose that happens to be long", blockBytes);
+    corpus += "=> /index.gmi Back\n";
+    return corpus;
+}
+
+static std::size_t getlineRebuild(const std::string& source)
+{
+    std::size_t bytes = 0;
+    for (const auto& node : parseGeminiNodes(source))
+    {
+        if (node.type != GeminiNodeType::PreformattedText)
+            continue;
+        std::stringstream ss;
+        std::string line;
+        std::string content;
+        ss << node.orig_text;
+        std::getline(ss, line);
+        while (std::getline(ss, line))
+            content += line + "\n";
+        bytes += content.size();
+    }
+    return bytes;
+}
+
+template <typename Function>
+static double megabytesPerSecond(const std::string& corpus, std::size_t rounds, Function&& run)
+{
+    std::size_t produced = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t round = 0; round < rounds; ++round)
+        produced += run(corpus);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (produced == 0)
+        std::fprintf(stderr, "warning: nothing produced\n");
+    return static_cast<double>(corpus.size() * rounds) / elapsed.count() / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 20;
+    const std::size_t blockBytes = argc > 2 ? std::stoul(argv[2]) : 4 << 20;
+    const auto corpus = makeCorpus(blockBytes);
+
+    const auto views = megabytesPerSecond(corpus, rounds, [](const std::string& source) {
+        return parseGeminiNodes(source).size();
+    });
+    const auto copying = megabytesPerSecond(corpus, rounds, [](const std::string& source) {
+        return parseGemini(source).size();
+    });
+    const auto rebuilt = megabytesPerSecond(corpus, rounds, getlineRebuild);
+    const auto html = megabytesPerSecond(corpus, rounds, [](const std::string& source) {
+        return render2Html(source, true).first.size();
+    });
+
+    std::printf("corpus             : %10.1f MB\n", corpus.size() / 1e6);
+    std::printf("parseGeminiNodes   : %10.1f MB/s\n", views);
+    std::printf("parseGemini        : %10.1f MB/s\n", copying);
+    std::printf("getline rebuild    : %10.1f MB/s\n", rebuilt);
+    std::printf("render2Html (ext.) : %10.1f MB/s\n", html);
+}
@@ -0,0 +1,141 @@
+// Load generator for a running test_server. Start test_server first, then:
+//
+//   server_bench throughput [requests] [concurrency]
+//   server_bench latency [requests] [concurrency]
+//
+// `throughput` measures response bytes/sec for 1 KB, 64 KB and 8 MB bodies.
+// `latency` reports p50/p99 request latency over the test_server handlers.
+// Compare the two loop modes by flipping "use_drogon_io_loops" in
+// test_server's drogon.config.json.
+#include <dremini/GeminiClient.hpp>
+#include <drogon/drogon.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+
+namespace
+{
+constexpr intmax_t kMaxBodySize = 16 * 1024 * 1024;
+
+struct RunResult
+{
+    std::size_t completed = 0;
+    std::size_t failed = 0;
+    std::size_t bytes = 0;
+    double seconds = 0;
+    std::vector<double> latencies;
+};
+
+// Keeps `concurrency` requests in flight until `requests` have completed.
+RunResult run(const std::string& url, std::size_t requests, std::size_t concurrency)
+{
+    struct Shared
+    {
+        std::string url;
+        std::size_t requests;
+        std::atomic<std::size_t> issued{0};
+        std::atomic<std::size_t> done{0};
+        std::atomic<std::size_t> failed{0};
+        std::atomic<std::size_t> bytes{0};
+        std::mutex latencyMutex;
+        std::vector<double> latencies;
+        std::promise<void> finished;
+    };
+    auto shared = std::make_shared<Shared>();
+    shared->url = url;
+    shared->requests = requests;
+
+    std::function<void()> issue;
+    issue = [shared, &issue]() {
+        if (shared->issued.fetch_add(1) >= shared->requests)
+            return;
+        const auto sent = std::chrono::steady_clock::now();
+        dremini::sendRequest(shared->url, [shared, &issue, sent](ReqResult result, const HttpResponsePtr& resp) {
+            const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - sent;
+            {
+                std::lock_guard<std::mutex> lock(shared->latencyMutex);
+                shared->latencies.push_back(latency.count());
+            }
+            if (result == ReqResult::Ok && resp)
+                shared->bytes += resp->body().size();
+            else
+                ++shared->failed;
+            if (shared->done.fetch_add(1) + 1 == shared->requests)
+                shared->finished.set_value();
+            else
+                issue();
+        }, 30, app().getLoop(), kMaxBodySize);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < concurrency; ++i)
+        app().getLoop()->queueInLoop(issue);
+    shared->finished.get_future().wait();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return {shared->done, shared->failed, shared->bytes, elapsed.count(), std::move(shared->latencies)};
+}
+
+void throughput(std::size_t requests, std::size_t concurrency)
+{
+    for (const std::size_t size : {std::size_t{1024}, std::size_t{64 * 1024}, std::size_t{8 * 1024 * 1024}})
+    {
+        const auto n = size >= 1024 * 1024 ? std::max<std::size_t>(requests / 100, 1) : requests;
+        const auto result = run("gemini://127.0.0.1/benchmark/body?" + std::to_string(size), n, concurrency);
+        std::printf("%8zu B bodies: %6zu requests, %4zu failed, %10.2f MB/s, %8.0f requests/s\n",
+                    size, result.completed, result.failed,
+                    static_cast<double>(result.bytes) / result.seconds / (1024 * 1024),
+                    static_cast<double>(result.completed) / result.seconds);
+    }
+}
+double percentile(std::vector<double>& values, double p)
+{
+    if (values.empty())
+        return 0;
+    const auto index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void latency(std::size_t requests, std::size_t concurrency)
+{
+    for (const std::string path : {"/apitest", "/apitest2?hello", "/about.gmi", "/benchmark/body?1024"})
+    {
+        auto result = run("gemini://127.0.0.1" + path, requests, concurrency);
+        std::printf("%-22s p50 %8.3f ms  p99 %8.3f ms  (%zu failed)\n", path.c_str(),
+                    percentile(result.latencies, 0.50), percentile(result.latencies, 0.99), result.failed);
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const std::string mode = argc > 1 ? argv[1] : "throughput";
+    const std::size_t requests = argc > 2 ? std::stoul(argv[2]) : 2000;
+    const std::size_t concurrency = argc > 3 ? std::stoul(argv[3]) : 16;
+
+    std::promise<void> started;
+    std::thread thr([&]() {
+        app().getLoop()->queueInLoop([&started]() { started.set_value(); });
+        app().run();
+    });
+    started.get_future().wait();
+
+    if (mode == "throughput")
+        throughput(requests, concurrency);
+    else if (mode == "latency")
+        latency(requests, concurrency);
+    else
+        std::fprintf(stderr, "unknown mode: %s\n", mode.c_str());
+
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    thr.join();
+}
@@ -0,0 +1,117 @@
+// Handshake cost with and without TLS session resumption. Start test_server
+// first, then:
+//
+//   tls_resumption_bench [requests] [host] [port]
+//
+// Each request is a fresh connection, as Gemini requires. The resumed run
+// offers the session from the previous connection and reports how many
+// handshakes the server actually resumed.
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+struct RunResult
+{
+    std::size_t completed = 0;
+    std::size_t resumed = 0;
+    double seconds = 0;
+};
+
+int connectTo(const std::string& host, unsigned short port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// One Gemini request per connection. Reads the response to the end, which
+// is also when a TLS 1.3 server has delivered its session ticket.
+RunResult run(SSL_CTX* ctx, const std::string& host, unsigned short port, std::size_t requests, bool resume)
+{
+    const std::string request = "gemini://" + host + "/apitest\r\n";
+    SSL_SESSION* session = nullptr;
+    RunResult result;
+    char buffer[4096];
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < requests; i++)
+    {
+        const int fd = connectTo(host, port);
+        if (fd < 0)
+            break;
+        SSL* ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, fd);
+        SSL_set_tlsext_host_name(ssl, host.c_str());
+        if (resume && session != nullptr)
+            SSL_set_session(ssl, session);
+        if (SSL_connect(ssl) == 1 && SSL_write(ssl, request.data(), static_cast<int>(request.size())) > 0)
+        {
+            while (SSL_read(ssl, buffer, sizeof(buffer)) > 0)
+                ;
+            result.completed++;
+            if (SSL_session_reused(ssl))
+                result.resumed++;
+            if (resume)
+            {
+                SSL_SESSION_free(session);
+                session = SSL_get1_session(ssl);
+            }
+        }
+        else
+        {
+            ERR_clear_error();
+        }
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+        close(fd);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    SSL_SESSION_free(session);
+    return result;
+}
+
+void report(const char* name, const RunResult& result)
+{
+    std::printf("%-10s %8.1f handshakes/s  %zu completed  %zu resumed (%.1f%%)\n",
+                name,
+                result.completed / result.seconds,
+                result.completed,
+                result.resumed,
+                result.completed == 0 ? 0.0 : 100.0 * result.resumed / result.completed);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const std::size_t requests = argc > 1 ? std::stoul(argv[1]) : 2000;
+    const std::string host = argc > 2 ? argv[2] : "127.0.0.1";
+    const auto port = static_cast<unsigned short>(argc > 3 ? std::stoul(argv[3]) : 1965);
+
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    // test_server uses a self-signed certificate
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+
+    report("full", run(ctx, host, port, requests, false));
+    report("resumed", run(ctx, host, port, requests, true));
+
+    SSL_CTX_free(ctx);
+}
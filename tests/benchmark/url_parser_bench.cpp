@@ -0,0 +1,59 @@
+// Compares the request-line parser used by GeminiServer::onMessage with the
+// std::regex it replaced. Reports parsed request lines per second on one core.
+#include <dremini/GeminiUrl.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace dremini;
+
+template <typename Function>
+static double requestsPerSecond(const std::vector<std::string>& lines, std::size_t rounds, Function&& parse)
+{
+    std::size_t accepted = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t round = 0; round < rounds; ++round)
+        for (const auto& line : lines)
+            accepted += parse(line);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (accepted != lines.size() * rounds)
+        std::fprintf(stderr, "warning: %zu of %zu lines rejected\n", lines.size() * rounds - accepted,
+                     lines.size() * rounds);
+    return static_cast<double>(lines.size() * rounds) / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 200000;
+    const std::vector<std::string> lines{
+        "gemini://example.org/",
+        "gemini://example.org:1965/gemlog/2022-01-01-hello-world.gmi",
+        "gemini://127.0.0.1/search?some%20query%20text",
+        "titan://example.org/mail/draft;mime=text/plain;size=12",
+        "gemini://capsule.example.org/~user/a/rather/deep/path/index.gmi",
+    };
+
+    static const std::regex re(R"(([a-z]+):\/\/([^\/:]+)(?:\:([0-9]+))?(\/$|$|\/[^?]*)(?:\?(.*))?)");
+    const auto regexRate = requestsPerSecond(lines, rounds / 10, [](const std::string& line) {
+        std::smatch match;
+        if (!std::regex_match(line, match, re))
+            return false;
+        // The old code copied every component out of the match.
+        std::string scheme = match[1];
+        std::string authority = match[2];
+        std::string path = match[4];
+        std::string query = match[5];
+        return !scheme.empty() && !authority.empty();
+    });
+    const auto parserRate = requestsPerSecond(lines, rounds, [](const std::string& line) {
+        const auto url = parseGeminiUrl(line);
+        return url.has_value() && !url->authority.empty();
+    });
+
+    std::printf("std::regex      : %12.0f requests/s\n", regexRate);
+    std::printf("parseGeminiUrl  : %12.0f requests/s\n", parserRate);
+    std::printf("speedup         : %12.1fx\n", parserRate / regexRate);
+}
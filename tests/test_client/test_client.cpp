@@ -1,9 +1,46 @@
+#include <trantor/net/TcpClient.h>
 #include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <chrono>
 #define DROGON_TEST_MAIN
+#include <dremini/GeminiBatch.hpp>
 #include <dremini/GeminiClient.hpp>
 #include <drogon/drogon_test.h>
 using namespace drogon;
 
+namespace
+{
+// A bare TLS connection to the test server, for requests sendRequest() would
+// never send. The client keeps itself alive until the server closes.
+void rawExchange(const std::string& name,
+                 std::function<void(const trantor::TcpConnectionPtr&)> onConnected,
+                 std::function<void(const std::string& received)> onClosed)
+{
+    auto client = std::make_shared<trantor::TcpClient>(app().getLoop(), trantor::InetAddress("127.0.0.1", 1965), name);
+    auto policy = trantor::TLSPolicy::defaultClientPolicy();
+    policy->setValidate(false).setAllowBrokenChain(true);
+    client->enableSSL(std::move(policy));
+    auto received = std::make_shared<std::string>();
+    client->setMessageCallback([received](const trantor::TcpConnectionPtr&, trantor::MsgBuffer* buf) {
+        received->append(buf->peek(), buf->readableBytes());
+        buf->retrieveAll();
+    });
+    auto self = std::make_shared<std::shared_ptr<trantor::TcpClient>>(client);
+    client->setConnectionCallback([self, received, onConnected = std::move(onConnected),
+                                   onClosed = std::move(onClosed)](const trantor::TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            onConnected(conn);
+            return;
+        }
+        onClosed(*received);
+        // Not from within the client's own callback
+        conn->getLoop()->queueInLoop([self]() { self->reset(); });
+    });
+    client->connect();
+}
+}  // namespace
+
 
 DROGON_TEST(GeminiTest)
 {
@@ -66,7 +103,227 @@ DROGON_TEST(GeminiTest)
         CHECK((int)resp->statusCode() == 200);
         CHECK(resp->body() == "hello");
     });
+
+    // Streamed responses arrive complete
+    dremini::sendRequest("gemini://127.0.0.1/stream", [TEST_CTX](ReqResult result, const HttpResponsePtr& resp){
+        REQUIRE(result == ReqResult::Ok);
+        REQUIRE(resp != nullptr);
+
+        CHECK(resp->getHeader("gemini-status") == "20");
+        const auto body = resp->body();
+        CHECK(body.substr(0, 7) == "line 0\n");
+        CHECK(body.size() > 10 && body.substr(body.size() - 11) == "line 99999\n");
+        CHECK(std::count(body.begin(), body.end(), '\n') == 100000);
+    }, 10, app().getLoop(), 0x1000000);
+
+    // Streamed requests deliver the header, then the body in chunks
+    {
+        struct Progress
+        {
+            int status = 0;
+            std::size_t bytes = 0;
+            std::size_t lines = 0;
+        };
+        auto progress = std::make_shared<Progress>();
+        dremini::GeminiStreamCallbacks callbacks;
+        callbacks.onHeader = [progress](int status, const std::string& meta, const dremini::GeminiStreamHandle&) {
+            progress->status = status;
+            return true;
+        };
+        callbacks.onChunk = [progress](std::string_view chunk) {
+            progress->bytes += chunk.size();
+            progress->lines += std::count(chunk.begin(), chunk.end(), '\n');
+            return true;
+        };
+        callbacks.onComplete = [TEST_CTX, progress](ReqResult result) {
+            CHECK(result == ReqResult::Ok);
+            CHECK(progress->status == 20);
+            CHECK(progress->lines == 100000);
+            CHECK(progress->bytes > 100000);
+        };
+        dremini::sendStreamRequest("gemini://127.0.0.1/stream", std::move(callbacks), 10);
+    }
+
+    // Aborting from a callback stops the request without completing it
+    {
+        dremini::GeminiStreamCallbacks callbacks;
+        callbacks.onHeader = [TEST_CTX](int status, const std::string&, const dremini::GeminiStreamHandle&) {
+            CHECK(status == 20);
+            return false;
+        };
+        callbacks.onComplete = [TEST_CTX](ReqResult) {
+            FAIL("aborted requests must not complete");
+        };
+        dremini::sendStreamRequest("gemini://127.0.0.1/stream", std::move(callbacks), 10);
+    }
+
+    // Cached responses are served without running the handler again
+    dremini::sendRequest("gemini://127.0.0.1/cached", [TEST_CTX](ReqResult result, const HttpResponsePtr& resp){
+        REQUIRE(result == ReqResult::Ok);
+        REQUIRE(resp != nullptr);
+        const auto first = std::string(resp->body());
+        dremini::sendRequest("gemini://127.0.0.1/cached", [TEST_CTX, first](ReqResult result, const HttpResponsePtr& resp){
+            REQUIRE(result == ReqResult::Ok);
+            REQUIRE(resp != nullptr);
+            CHECK(resp->getHeader("gemini-status") == "20");
+            CHECK(resp->body() == first);
+        });
+    });
+}
+
+DROGON_TEST(GeminiRedirectTest)
+{
+    auto context = std::make_shared<dremini::GeminiClientContext>();
+    dremini::RedirectPolicy policy;
+    policy.maxHops = 5;
+    context->setRedirectPolicy(policy);
+
+    // Relative redirects are followed and the hops reported
+    dremini::sendRequest("gemini://127.0.0.1/redirect/2", [TEST_CTX](ReqResult result, const HttpResponsePtr& resp){
+        REQUIRE(result == ReqResult::Ok);
+        REQUIRE(resp != nullptr);
+        CHECK(resp->getHeader("gemini-status") == "20");
+        CHECK(resp->body() == "Hello");
+        CHECK(resp->getHeader("gemini-redirects") ==
+              "gemini://127.0.0.1/redirect/2 gemini://127.0.0.1/redirect/1 "
+              "gemini://127.0.0.1/redirect/0 gemini://127.0.0.1/apitest");
+    }, 10, app().getLoop(), -1, {}, 0, dremini::kNoVerification, context);
+
+    // Chains longer than the policy allows end with the last redirect
+    dremini::sendRequest("gemini://127.0.0.1/redirect/9", [TEST_CTX](ReqResult result, const HttpResponsePtr& resp){
+        REQUIRE(result == ReqResult::Ok);
+        REQUIRE(resp != nullptr);
+        CHECK(resp->getHeader("gemini-status")[0] == '3');
+        CHECK(resp->getHeader("meta") == "3");
+    }, 10, app().getLoop(), -1, {}, 0, dremini::kNoVerification, context);
+
+    // Loops are detected
+    dremini::sendRequest("gemini://127.0.0.1/redirect-loop", [TEST_CTX](ReqResult result, const HttpResponsePtr& resp){
+        REQUIRE(result == ReqResult::Ok);
+        REQUIRE(resp != nullptr);
+        CHECK(resp->getHeader("gemini-status")[0] == '3');
+        CHECK(resp->getHeader("gemini-redirects").empty());
+    }, 10, app().getLoop(), -1, {}, 0, dremini::kNoVerification, context);
+
+    // Without a policy the redirect is returned as is
+    dremini::sendRequest("gemini://127.0.0.1/redirect/0", [TEST_CTX](ReqResult result, const HttpResponsePtr& resp){
+        REQUIRE(result == ReqResult::Ok);
+        REQUIRE(resp != nullptr);
+        CHECK(resp->getHeader("gemini-status")[0] == '3');
+        CHECK(resp->getHeader("meta") == "/apitest");
+    }, 10);
+}
+
+DROGON_TEST(GeminiReadTimeoutTest)
+{
+    // A request line that never completes is closed once request_line (2s
+    // in the test config) has passed, without a response
+    const auto start = std::chrono::steady_clock::now();
+    rawExchange("SlowRequestLine",
+        [](const trantor::TcpConnectionPtr& conn) { conn->send("gemini://127.0.0.1/apitest"); },
+        [TEST_CTX, start](const std::string& received) {
+            CHECK(received.empty());
+            CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        });
+
+    // A Titan body that keeps arriving is never cut off, even though it takes
+    // longer than titan_body in total
+    rawExchange("SteadyTitanUpload",
+        [](const trantor::TcpConnectionPtr& conn) {
+            conn->send("titan://127.0.0.1/titan/upload;mime=text/plain;size=6\r\n");
+            const std::string body = "hello!";
+            for (std::size_t i = 0; i < body.size(); ++i)
+            {
+                conn->getLoop()->runAfter(0.5 * static_cast<double>(i + 1),
+                    [weakConn = std::weak_ptr<trantor::TcpConnection>(conn), byte = body.substr(i, 1)]() {
+                        if (const auto conn = weakConn.lock())
+                            conn->send(byte);
+                    });
+            }
+        },
+        [TEST_CTX](const std::string& received) {
+            CHECK(received.rfind("20 ", 0) == 0);
+            CHECK(received.find("POST|/titan/upload|hello!|text/plain|") != std::string::npos);
+        });
+}
+
+DROGON_TEST(GeminiBatchTest)
+{
+    // Every URL gets exactly one result, invalid ones without a request
+    std::vector<std::string> urls;
+    for (int i = 0; i < 20; i++)
+        urls.push_back("gemini://127.0.0.1/apitest2?" + std::to_string(i));
+    urls.push_back("not a url");
+
+    struct Seen
+    {
+        std::mutex mutex;
+        std::vector<int> results = std::vector<int>(21, 0);
+    };
+    auto seen = std::make_shared<Seen>();
+    dremini::BatchOptions options;
+    options.maxInFlightPerHost = 4;
+    dremini::sendBatchRequest(urls,
+        [TEST_CTX, seen](const dremini::BatchResult& result) {
+            std::lock_guard<std::mutex> lock(seen->mutex);
+            seen->results[result.index]++;
+            if (result.index == 20)
+            {
+                CHECK(result.result == ReqResult::BadServerAddress);
+                return;
+            }
+            CHECK(result.result == ReqResult::Ok);
+            REQUIRE(result.response != nullptr);
+            CHECK(result.response->body() == std::to_string(result.index));
+        },
+        [TEST_CTX, seen](const dremini::BatchStats& stats) {
+            CHECK(stats.requests == 21);
+            CHECK(stats.succeeded == 20);
+            CHECK(stats.failed == 1);
+            std::lock_guard<std::mutex> lock(seen->mutex);
+            CHECK(std::all_of(seen->results.begin(), seen->results.end(), [](int count) { return count == 1; }));
+        },
+        options);
+}
+
+#ifdef __cpp_impl_coroutine
+DROGON_TEST(GeminiChunkReaderTest)
+{
+    // Chunks can be consumed as they arrive from a coroutine
+    sync_wait([TEST_CTX]() -> Task<> {
+        auto reader = dremini::sendStreamRequestCoro("gemini://127.0.0.1/stream");
+        const auto [status, meta] = co_await reader.header();
+        CHECK(status == 20);
+        std::size_t lines = 0;
+        while (auto chunk = co_await reader.next())
+            lines += std::count(chunk->begin(), chunk->end(), '\n');
+        CHECK(lines == 100000);
+    }());
+
+    // Failures surface as exceptions, as with sendRequestCoro()
+    sync_wait([TEST_CTX]() -> Task<> {
+        auto reader = dremini::sendStreamRequestCoro("gemini://127.0.0.1:1/", 2);
+        bool failed = false;
+        try
+        {
+            co_await reader.header();
+        }
+        catch (const std::runtime_error&)
+        {
+            failed = true;
+        }
+        CHECK(failed);
+    }());
+
+    // Abandoning a reader mid-stream aborts the request
+    sync_wait([TEST_CTX]() -> Task<> {
+        auto reader = dremini::sendStreamRequestCoro("gemini://127.0.0.1/stream");
+        co_await reader.header();
+        auto chunk = co_await reader.next();
+        CHECK(chunk.has_value());
+    }());
 }
+#endif
 
 int main(int argc, char** argv) 
 {
@@ -1,5 +1,6 @@
 #include <drogon/drogon.h>
 #include <dremini/GeminiServer.hpp>
+#include <atomic>
 #include <memory>
 #include <trantor/net/EventLoopThreadPool.h>
 #include <dremini/GeminiServerPlugin.hpp>
@@ -62,6 +63,66 @@ int main()
             resp->setContentTypeCode(CT_TEXT_PLAIN);
             callback(resp);
         }, {Post});
+    app().registerHandler("/cached",
+        [](const HttpRequestPtr& req,
+           std::function<void (const HttpResponsePtr &)> &&callback)
+        {
+            // Counts the requests that actually reach the handler
+            static std::atomic<int> calls{0};
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setBody(std::to_string(++calls));
+            resp->setContentTypeCode(CT_TEXT_PLAIN);
+            resp->addHeader(kGeminiCacheTtlHeader, "60");
+            callback(resp);
+        });
+    app().registerHandler("/stream",
+        [](const HttpRequestPtr& req,
+           std::function<void (const HttpResponsePtr &)> &&callback)
+        {
+            // 100000 numbered lines, produced only as the client reads them
+            auto next = std::make_shared<int>(0);
+            auto resp = HttpResponse::newStreamResponse([next](char* buffer, std::size_t size) -> std::size_t {
+                if(buffer == nullptr)
+                    return 0;
+                std::size_t written = 0;
+                while(*next < 100000)
+                {
+                    const auto line = "line " + std::to_string(*next) + "\n";
+                    if(written + line.size() > size)
+                        break;
+                    std::copy(line.begin(), line.end(), buffer + written);
+                    written += line.size();
+                    ++*next;
+                }
+                return written;
+            }, "", CT_TEXT_PLAIN);
+            callback(resp);
+        });
+    app().registerHandler("/redirect/{hops}",
+        [](const HttpRequestPtr& req,
+           std::function<void (const HttpResponsePtr &)> &&callback,
+           int hops)
+        {
+            // Counts down through relative redirects, ending at /apitest
+            callback(HttpResponse::newRedirectionResponse(hops > 0 ? std::to_string(hops - 1) : "/apitest"));
+        });
+    app().registerHandler("/redirect-loop",
+        [](const HttpRequestPtr& req,
+           std::function<void (const HttpResponsePtr &)> &&callback)
+        {
+            callback(HttpResponse::newRedirectionResponse("gemini://127.0.0.1/redirect-loop"));
+        });
+    // Used by server_bench: replies with a text/plain body of `query` bytes.
+    app().registerHandler("/benchmark/body",
+        [](const HttpRequestPtr& req,
+           std::function<void (const HttpResponsePtr &)> &&callback)
+        {
+            const auto size = std::stoul("0" + req->getParameter("query"));
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setBody(std::string(size, 'x'));
+            resp->setContentTypeCode(CT_TEXT_PLAIN);
+            callback(resp);
+        });
     app().loadConfigFile("drogon.config.json");
 
     app().run();
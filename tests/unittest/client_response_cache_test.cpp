@@ -0,0 +1,194 @@
+#include <dremini/ClientResponseCache.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+using namespace dremini;
+using namespace std::chrono_literals;
+
+namespace
+{
+// Fetches that stay pending until the test answers them
+struct FakeNetwork
+{
+    std::vector<std::pair<std::string, ClientResponseCache::Callback>> pending;
+
+    ClientResponseCache::Fetch fetch()
+    {
+        return [this](const std::string& url, ClientResponseCache::Callback done) {
+            pending.emplace_back(url, std::move(done));
+        };
+    }
+    void answer(int status, const std::string& body)
+    {
+        auto [url, done] = std::move(pending.front());
+        pending.erase(pending.begin());
+        done(ReqResult::Ok, internal::makeGeminiResponse(status, "text/gemini", body));
+    }
+    void fail()
+    {
+        auto [url, done] = std::move(pending.front());
+        pending.erase(pending.begin());
+        done(ReqResult::NetworkFailure, nullptr);
+    }
+};
+
+// Records the body each callback was given, or "!" on failure
+ClientResponseCache::Callback record(std::vector<std::string>& bodies)
+{
+    return [&bodies](ReqResult result, const HttpResponsePtr& response) {
+        bodies.push_back(result == ReqResult::Ok ? std::string(response->body()) : "!");
+    };
+}
+}  // namespace
+
+DROGON_TEST(ClientResponseCacheNormalisation)
+{
+    CHECK(ClientResponseCache::normaliseUrl("GEMINI://Example.ORG") == "gemini://example.org/");
+    CHECK(ClientResponseCache::normaliseUrl("gemini://example.org:1965/a?b#c") == "gemini://example.org/a?b");
+    CHECK(ClientResponseCache::normaliseUrl("gemini://example.org:1966/A") == "gemini://example.org:1966/A");
+    CHECK(ClientResponseCache::normaliseUrl("gemini://[::1]/") == "gemini://[::1]/");
+    CHECK(!ClientResponseCache::normaliseUrl("https://example.org/"));
+    CHECK(!ClientResponseCache::normaliseUrl("not a url"));
+}
+
+DROGON_TEST(ClientResponseCacheFreshness)
+{
+    FakeNetwork network;
+    auto cache = std::make_shared<ClientResponseCache>();
+    CachePolicy policy;
+    policy.maxAge = 60s;
+    policy.staleWhileRevalidate = 60s;
+    const auto start = ClientResponseCache::Clock::now();
+    std::vector<std::string> bodies;
+
+    // Concurrent misses share one fetch
+    cache->get("gemini://example.org/feed", policy, network.fetch(), record(bodies), start);
+    cache->get("gemini://EXAMPLE.org:1965/feed", policy, network.fetch(), record(bodies), start);
+    REQUIRE(network.pending.size() == 1);
+    network.answer(20, "v1");
+    CHECK(bodies.size() == 2);
+    CHECK(bodies.back() == "v1");
+
+    // Fresh hits are answered at once
+    cache->get("gemini://example.org/feed", policy, network.fetch(), record(bodies), start + 30s);
+    CHECK(network.pending.empty());
+    CHECK(bodies.back() == "v1");
+
+    // Stale hits are answered at once and refreshed once in the background
+    cache->get("gemini://example.org/feed", policy, network.fetch(), record(bodies), start + 90s);
+    cache->get("gemini://example.org/feed", policy, network.fetch(), record(bodies), start + 90s);
+    CHECK(bodies.size() == 5);
+    CHECK(bodies.back() == "v1");
+    REQUIRE(network.pending.size() == 1);
+    network.answer(20, "v2");
+    cache->get("gemini://example.org/feed", policy, network.fetch(), record(bodies), start + 100s);
+    CHECK(bodies.back() == "v2");
+
+    // Past the stale window the response is fetched again
+    cache->get("gemini://example.org/feed", policy, network.fetch(), record(bodies), start + 300s);
+    REQUIRE(network.pending.size() == 1);
+    network.fail();
+    CHECK(bodies.back() == "!");
+
+    // Errors are passed on but not cached
+    cache->get("gemini://example.org/missing", policy, network.fetch(), record(bodies), start);
+    network.answer(51, "");
+    cache->get("gemini://example.org/missing", policy, network.fetch(), record(bodies), start);
+    CHECK(network.pending.size() == 1);
+
+    const auto stats = cache->stats();
+    CHECK(stats.hits == 2);
+    CHECK(stats.staleHits == 2);
+    CHECK(stats.misses == 4);
+    CHECK(stats.coalesced == 1);
+    CHECK(stats.revalidations == 1);
+}
+
+DROGON_TEST(ClientResponseCacheMemoryBound)
+{
+    FakeNetwork network;
+    ClientCacheOptions options;
+    options.maxBytes = 3 * 1024;
+    auto cache = std::make_shared<ClientResponseCache>(options);
+    std::vector<std::string> bodies;
+
+    for (int i = 0; i < 5; i++)
+    {
+        cache->get("gemini://example.org/" + std::to_string(i), {}, network.fetch(), record(bodies));
+        network.answer(20, std::string(1000, 'x'));
+    }
+    CHECK(cache->sizeBytes() <= options.maxBytes);
+    CHECK(cache->stats().evictions == 3);
+
+    // The most recent responses are kept
+    cache->get("gemini://example.org/4", {}, network.fetch(), record(bodies));
+    CHECK(network.pending.empty());
+    cache->get("gemini://example.org/0", {}, network.fetch(), record(bodies));
+    CHECK(network.pending.size() == 1);
+}
+
+DROGON_TEST(ClientResponseCacheDiskTier)
+{
+    const std::string directory = "client_response_cache_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directory(directory);
+    ClientCacheOptions options;
+    options.diskDirectory = directory;
+    const std::string url = "gemini://example.org/disk";
+
+    // Disk misses fetch from the disk completion loop. The test answers from
+    // its own thread, as the network would.
+    std::atomic<int> fetches{0};
+    std::promise<ClientResponseCache::Callback> fetched;
+    const ClientResponseCache::Fetch fetch = [&](const std::string&, ClientResponseCache::Callback done) {
+        fetches++;
+        fetched.set_value(std::move(done));
+    };
+    const auto get = [&](const std::shared_ptr<ClientResponseCache>& cache, bool answer) {
+        std::promise<HttpResponsePtr> done;
+        cache->get(url, {}, fetch, [&done](ReqResult result, const HttpResponsePtr& response) {
+            done.set_value(result == ReqResult::Ok ? response : nullptr);
+        });
+        if (answer)
+            fetched.get_future().get()(ReqResult::Ok,
+                                       internal::makeGeminiResponse(20, "text/gemini", "line\nanother line\n"));
+        return done.get_future().get();
+    };
+
+    REQUIRE(get(std::make_shared<ClientResponseCache>(options), true) != nullptr);
+    CHECK(fetches == 1);
+
+    // A new cache finds the response on disk
+    auto cache = std::make_shared<ClientResponseCache>(options);
+    const auto response = get(cache, false);
+    REQUIRE(response != nullptr);
+    CHECK(fetches == 1);
+    CHECK(response->body() == "line\nanother line\n");
+    CHECK(response->getHeader("gemini-status") == "20");
+    CHECK(response->getHeader("meta") == "text/gemini");
+    CHECK(cache->stats().diskHits == 1);
+    CHECK(cache->stats().misses == 0);
+
+    // A callback may drop the last reference to the cache. Its destructor
+    // waits for the disk thread, so that must not be where callbacks run.
+    {
+        std::promise<void> released;
+        auto last = std::make_shared<ClientResponseCache>(options);
+        auto* owner = last.get();
+        owner->get(url, {}, fetch, [&released, last = std::move(last)](ReqResult, const HttpResponsePtr&) mutable {
+            last.reset();
+            released.set_value();
+        });
+        CHECK(released.get_future().wait_for(10s) == std::future_status::ready);
+    }
+
+    cache.reset();
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,111 @@
+#include <dremini/DnsCache.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <string>
+#include <vector>
+
+using namespace dremini;
+using namespace std::chrono_literals;
+
+namespace
+{
+// Lookups that stay pending until the test completes them
+struct FakeResolver
+{
+    std::vector<std::pair<std::string, DnsCache::Callback>> pending;
+
+    DnsCache::Lookup lookup()
+    {
+        return [this](const std::string& host, DnsCache::Callback done) {
+            pending.emplace_back(host, std::move(done));
+        };
+    }
+    void answer(const trantor::InetAddress& address)
+    {
+        auto [host, done] = std::move(pending.front());
+        pending.erase(pending.begin());
+        done(address);
+    }
+    // The way trantor's resolvers report a failed lookup
+    void fail()
+    {
+        answer(trantor::InetAddress{});
+    }
+};
+}  // namespace
+
+DROGON_TEST(DnsCacheCoalescingAndTtl)
+{
+    FakeResolver resolver;
+    DnsCacheOptions options;
+    options.positiveTtl = 60s;
+    options.negativeTtl = 5s;
+    DnsCache cache(options, resolver.lookup());
+    const auto start = DnsCache::Clock::time_point{} + 1h;
+    const trantor::InetAddress address("192.0.2.1", 0);
+
+    // Concurrent lookups of one host share a single query
+    std::vector<std::string> results;
+    auto record = [&results](const trantor::InetAddress& resolved) { results.push_back(resolved.toIp()); };
+    cache.resolve("example.org", record, start);
+    cache.resolve("example.org", record, start);
+    CHECK(resolver.pending.size() == 1);
+    CHECK(results.empty());
+    resolver.answer(address);
+    CHECK(results.size() == 2);
+    CHECK(results[0] == "192.0.2.1");
+    CHECK(results[1] == "192.0.2.1");
+
+    // Answered from the cache until the TTL runs out
+    cache.resolve("example.org", record, start + 59s);
+    CHECK(resolver.pending.empty());
+    CHECK(results.size() == 3);
+    cache.resolve("example.org", record, start + 60s);
+    CHECK(resolver.pending.size() == 1);
+    resolver.answer(address);
+
+    // Failures are cached for the shorter negative TTL
+    cache.resolve("missing.example", record, start);
+    resolver.fail();
+    cache.resolve("missing.example", record, start + 4s);
+    CHECK(resolver.pending.empty());
+    CHECK(results.back() == "0.0.0.0");
+    cache.resolve("missing.example", record, start + 5s);
+    REQUIRE(resolver.pending.size() == 1);
+    resolver.fail();
+
+    const auto stats = cache.stats();
+    CHECK(stats.misses == 4);
+    CHECK(stats.coalesced == 1);
+    CHECK(stats.hits == 1);
+    CHECK(stats.negativeHits == 1);
+    CHECK(stats.failures == 2);
+}
+
+DROGON_TEST(DnsCacheBounded)
+{
+    FakeResolver resolver;
+    DnsCacheOptions options;
+    options.maxEntries = 2;
+    DnsCache cache(options, resolver.lookup());
+    const auto now = DnsCache::Clock::time_point{} + 1h;
+    auto ignore = [](const trantor::InetAddress&) {};
+
+    for (const auto host : {"a.example", "b.example"})
+    {
+        cache.resolve(host, ignore, now);
+        resolver.answer(trantor::InetAddress("192.0.2.1", 0));
+    }
+    // Touch a.example so b.example is the least recently used
+    cache.resolve("a.example", ignore, now);
+    cache.resolve("c.example", ignore, now);
+    resolver.answer(trantor::InetAddress("192.0.2.3", 0));
+    CHECK(cache.size() == 2);
+    CHECK(cache.stats().evictions == 1);
+
+    cache.resolve("a.example", ignore, now);
+    CHECK(resolver.pending.empty());
+    cache.resolve("b.example", ignore, now);
+    CHECK(resolver.pending.size() == 1);
+}
@@ -0,0 +1,377 @@
+#include <dremini/GeminiParser.hpp>
+#include <dremini/NewlineScanner.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace dremini;
+
+namespace
+{
+// The line-by-line parser parseGemini() used before it was rebuilt around
+// internal::findNewlines(), kept verbatim as the reference for the fuzz test.
+bool startsWith(const std::string_view sv, const std::string_view target)
+{
+    if(sv.size() < target.size())
+        return false;
+    return sv.substr(0, target.size()) == target;
+}
+
+std::string_view ltrim(std::string_view s)
+{
+    s.remove_prefix(std::distance(s.cbegin(), std::find_if(s.cbegin(), s.cend(),
+         [](int c) {return !std::isspace(c);})));
+
+    return s;
+}
+
+std::string_view rtrim(std::string_view s)
+{
+    s.remove_suffix(std::distance(s.crbegin(), std::find_if(s.crbegin(), s.crend(),
+        [](int c) {return !std::isspace(c);})));
+
+    return s;
+}
+
+std::string trim(std::string s)
+{
+    return std::string(ltrim(rtrim(s)));
+}
+
+std::vector<GeminiASTNode> legacyParseGemini(const std::string_view str)
+{
+    std::vector<GeminiASTNode> nodes;
+    size_t last_pos = 0;
+    bool in_preformatted_text = false;
+    size_t preformatted_text_start = 0;
+    std::string preformatted_text_meta = "";
+    for(size_t i=0;i<str.size()+1;i++) {
+        if((i == str.size() && i != 0 && str[i-1] != '\n')|| (i < str.size() && str[i] == '\n')) {
+            if(in_preformatted_text == false) {
+                std::string_view line(str.data()+last_pos, i-last_pos);
+                auto crlf = line.find_last_not_of("\r\n");
+                if(crlf != std::string_view::npos)
+                    line = std::string_view(line.data(), crlf+1);
+                else
+                    line = std::string_view(line.data(), 0);
+
+                GeminiASTNode node;
+                node.orig_text = line;
+                if(startsWith(line, "=>")) {
+                    std::string_view sv = line.substr(2);
+                    std::string_view link;
+                    std::string_view text;
+                    auto link_start = sv.find_first_not_of(" \t");
+                    if(link_start != std::string_view::npos) {
+                        sv = sv.substr(link_start);
+                        auto link_end = sv.find_first_of(" \t");
+                        link = sv.substr(0, link_end);
+                        if(link_end != std::string_view::npos) {
+                            sv = sv.substr(link_end);
+                            auto text_start = sv.find_first_not_of(" \t");
+                            if(text_start != std::string_view::npos) {
+                                sv = sv.substr(text_start);
+                                auto text_end = sv.find_last_not_of(" \t");
+                                text = sv.substr(0, text_end == std::string_view::npos? text_end : text_end+1);
+                            }
+                        }
+                    }
+                    node.text = text;
+                    node.meta = link;
+                    node.type = "link";
+                }
+                else if(startsWith(line, "###")) {
+                    node.text = trim(std::string(line.substr(3)));
+                    node.type = "heading3";
+                }
+                else if(startsWith(line, "##")) {
+                    node.text = trim(std::string(line.substr(2)));
+                    node.type = "heading2";
+                }
+                else if(startsWith(line, "#")) {
+                    node.text = trim(std::string(line.substr(1)));
+                    node.type = "heading1";
+                }
+                else if(startsWith(line, "* ")) {
+                    node.text = ltrim(line.substr(1));
+                    node.type = "list";
+                }
+                else if(startsWith(line, ">")) {
+                    node.text = line.substr(1);
+                    node.type = "quote";
+                }
+                else if(startsWith(line, "```")) {
+                    preformatted_text_meta = line.substr(3);
+                    in_preformatted_text = true;
+                    preformatted_text_start = last_pos;
+                    last_pos = i+1;
+                    continue;
+                }
+                else {
+                    node.text = line;
+                    node.type = "text";
+                }
+                last_pos = i+1;
+
+                nodes.emplace_back(std::move(node));
+            }
+            else {
+                std::string_view line(str.data()+last_pos, i-last_pos);
+                auto crlf = line.find_last_not_of("\r\n");
+                if(crlf != std::string_view::npos)
+                    line = std::string_view(line.data(), crlf+1);
+                last_pos = i+1;
+
+                if(startsWith(line, "```")) {
+                    std::string_view preformatted_text(str.data()+preformatted_text_start, i-preformatted_text_start);
+                    GeminiASTNode node;
+                    node.orig_text = preformatted_text;
+
+                    std::stringstream ss;
+                    std::string line;
+                    std::string content;
+                    ss << preformatted_text;
+                    std::getline(ss, line);
+                    if(line.size() > 3)
+                        node.meta = line.substr(4);
+
+                    while(std::getline(ss, line)) {
+                        if(line.find("```") != 0)
+                            content += line + "\n";
+                    }
+                    node.text = content;
+                    node.meta = preformatted_text_meta;
+                    node.type = "preformatted_text";
+                    in_preformatted_text = false;
+                    nodes.emplace_back(std::move(node));
+                }
+            }
+        }
+    }
+    return nodes;
+}
+
+bool sameNodes(const std::vector<GeminiASTNode>& lhs, const std::vector<GeminiASTNode>& rhs)
+{
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const auto& a, const auto& b) {
+        return a.orig_text == b.orig_text && a.text == b.text && a.type == b.type && a.meta == b.meta;
+    });
+}
+// A random mutation of a seed document, for the fuzz tests
+std::string mutatedGemtext(std::mt19937& rng)
+{
+    static const std::vector<std::string> seeds{
+        "# Title\n\nSome text\n=> gemini://example.org/ Example\n* item\n> quote\n",
+        "## Sub\r\n### Subsub \r\n#\n##\n###\n####deep\n",
+        "```ascii\n  /\\_/\\\n\n```\nafter\n```\nunterminated\n",
+        "=>\n=> \t\n=>link\n=>  link  text with  spaces \t\n",
+        "*not a list\n* \n*\n>\n> \n\r\n\r\r\n",
+        "text without a trailing newline",
+        "```\r\n```\r\n``\n`\n```` meta ```\nx\n```` \n",
+    };
+    static const std::string alphabet = "#=>*` \t\r\n\n\nax\x80\xff";
+
+    std::string input = seeds[rng() % seeds.size()];
+    const auto mutations = 1 + rng() % 8;
+    for (std::size_t mutation = 0; mutation < mutations; ++mutation)
+    {
+        const auto position = input.empty() ? 0 : rng() % input.size();
+        const auto character = alphabet[rng() % alphabet.size()];
+        switch (rng() % 4)
+        {
+        case 0: input.insert(input.begin() + position, character); break;
+        case 1: if (!input.empty()) input.erase(input.begin() + position); break;
+        case 2: input += seeds[rng() % seeds.size()]; break;
+        default: if (!input.empty()) input[position] = character; break;
+        }
+    }
+    return input;
+}
+
+GeminiASTNode copyNode(const GeminiNode& node)
+{
+    return GeminiASTNode{std::string(node.orig_text), std::string(node.text), std::string(nodeTypeName(node.type)),
+                         std::string(node.meta)};
+}
+
+// Every line break in `text`, collected a batch at a time
+std::vector<std::size_t> allNewlines(std::string_view text, internal::NewlineScanKernel kernel)
+{
+    std::vector<std::size_t> offsets;
+    internal::NewlineBatch batch;
+    for (std::size_t scanned = 0; scanned < text.size();)
+    {
+        const auto base = scanned;
+        scanned += internal::findNewlines(text.substr(base), batch, kernel);
+        for (std::size_t i = 0; i < batch.size; ++i)
+            offsets.push_back(base + batch.offsets[i]);
+    }
+    return offsets;
+}
+}  // namespace
+
+DROGON_TEST(NewlineScanKernels)
+{
+    const auto& kernels = internal::supportedNewlineScanKernels();
+    REQUIRE(!kernels.empty());
+    CHECK(kernels.front() == internal::NewlineScanKernel::Scalar);
+
+    // Newlines on and around every 16 and 32 byte boundary, read from every
+    // alignment, so each kernel's vector loop and scalar tail both get used
+    std::string text(200, 'x');
+    for (std::size_t i = 0; i < text.size(); i += 7)
+        text[i] = '\n';
+    text[15] = text[16] = text[31] = text[32] = text[63] = '\n';
+    text.back() = '\n';
+
+    for (std::size_t offset = 0; offset < 40; ++offset)
+    {
+        const std::string_view view = std::string_view(text).substr(offset);
+        std::vector<std::size_t> expected;
+        for (std::size_t i = 0; i < view.size(); ++i)
+            if (view[i] == '\n')
+                expected.push_back(i);
+
+        for (const auto kernel : kernels)
+            CHECK(allNewlines(view, kernel) == expected);
+    }
+
+    // Texts with more line breaks than a batch holds are scanned in several
+    // calls, each resuming where the last stopped
+    std::string dense(3 * internal::NewlineBatch::kCapacity + 45, '\n');
+    for (std::size_t i = 0; i < dense.size(); i += 5)
+        dense[i] = 'x';
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 0; i < dense.size(); ++i)
+        if (dense[i] == '\n')
+            expected.push_back(i);
+    for (const auto kernel : kernels)
+    {
+        internal::NewlineBatch batch;
+        CHECK(internal::findNewlines(dense, batch, kernel) < dense.size());
+        CHECK(batch.size <= internal::NewlineBatch::kCapacity);
+        CHECK(allNewlines(dense, kernel) == expected);
+    }
+
+    internal::NewlineBatch none;
+    CHECK(internal::findNewlines("", none) == 0);
+    CHECK(none.size == 0);
+    CHECK(internal::findNewlines(std::string(100, 'x'), none) == 100);
+    CHECK(none.size == 0);
+}
+
+DROGON_TEST(GeminiParserFuzzCorpus)
+{
+    std::mt19937 rng(1965);
+    for (std::size_t iteration = 0; iteration < 20000; ++iteration)
+    {
+        const auto input = mutatedGemtext(rng);
+        CHECK(sameNodes(parseGemini(input), legacyParseGemini(input)));
+    }
+
+    // Documents with many more lines than one newline batch
+    for (std::size_t iteration = 0; iteration < 20; ++iteration)
+    {
+        std::string input;
+        while (std::count(input.begin(), input.end(), '\n') < 2000)
+            input += mutatedGemtext(rng);
+        CHECK(sameNodes(parseGemini(input), legacyParseGemini(input)));
+    }
+}
+
+DROGON_TEST(GeminiStreamParserChunks)
+{
+    std::vector<GeminiASTNode> nodes;
+    GeminiStreamParser parser([&nodes](const GeminiNode& node) { nodes.push_back(copyNode(node)); });
+
+    std::mt19937 rng(1966);
+    for (std::size_t iteration = 0; iteration < 20000; ++iteration)
+    {
+        std::string input = mutatedGemtext(rng);
+        if (iteration % 2 == 0)
+            input += mutatedGemtext(rng);
+
+        // Split anywhere, including inside "\r\n" and ``` and into empty chunks
+        nodes.clear();
+        std::size_t pos = 0;
+        while (pos < input.size())
+        {
+            const auto size = std::min<std::size_t>(rng() % 12, input.size() - pos);
+            parser.feed(std::string_view(input).substr(pos, size));
+            pos += size;
+        }
+        parser.finish();
+        CHECK(parser.bufferedBytes() == 0);
+        CHECK(sameNodes(nodes, parseGemini(input)));
+    }
+}
+
+DROGON_TEST(GeminiStreamParserBufferLimit)
+{
+    std::size_t count = 0;
+    GeminiStreamParser parser([&count](const GeminiNode&) { ++count; }, 16);
+
+    // Complete lines are parsed straight from the chunk, however large it is
+    parser.feed(std::string(100, 'a') + "\n" + std::string(100, 'b') + "\nend");
+    CHECK(count == 2);
+    CHECK(parser.bufferedBytes() == 3);
+
+    CHECK_THROWS_AS(parser.feed(std::string(20, 'c')), std::runtime_error);
+    CHECK(parser.bufferedBytes() == 0);
+
+    // An open preformatted block is held until it closes
+    count = 0;
+    parser.feed("```\nshort\n");
+    CHECK(parser.bufferedBytes() == 10);
+    CHECK_THROWS_AS(parser.feed("a longer line\n"), std::runtime_error);
+    parser.feed("```\n");
+    parser.finish();
+    CHECK(count == 0);
+
+    std::string text;
+    GeminiStreamParser blocks([&text](const GeminiNode& node) { text = node.text; }, 16);
+    blocks.feed("```\nshort\n");
+    blocks.feed("``");
+    blocks.feed("`\n");
+    CHECK(text == "short\n");
+    CHECK(blocks.bufferedBytes() == 0);
+}
+
+DROGON_TEST(GeminiStreamParserThrowingCallback)
+{
+    std::vector<std::string> lines;
+    GeminiStreamParser parser([&lines](const GeminiNode& node) {
+        if (node.text == "throw")
+            throw std::runtime_error("rejected");
+        lines.emplace_back(node.text);
+    });
+
+    // Thrown while parsing a buffered line and with more lines to go, from
+    // both the buffer and the chunk itself
+    const std::pair<const char*, const char*> splits[] = {{"thr", "ow\nlost\npartial"},
+                                                          {"", "throw\nlost\npartial"}};
+    for (const auto& [first, second] : splits)
+    {
+        lines.clear();
+        parser.feed(first);
+        CHECK_THROWS_AS(parser.feed(second), std::runtime_error);
+        CHECK(parser.bufferedBytes() == 0);
+        CHECK(lines.empty());
+
+        // The next document starts clean
+        parser.feed("```\nkept\n``");
+        parser.feed("`\nlast");
+        parser.finish();
+        REQUIRE(lines.size() == 2);
+        CHECK(lines[0] == "kept\n");
+        CHECK(lines[1] == "last");
+    }
+}
@@ -75,3 +75,69 @@ DROGON_TEST(GeminiRendererShowsPreformattedAltText)
     const auto escaped_html = render2Html(escaped_alt).first;
     CHECK(escaped_html.find("<figcaption>&lt;untrusted&gt;</figcaption>") != std::string::npos);
 }
+
+DROGON_TEST(GeminiParserNodes)
+{
+    const std::string source = "# Title \r\n=> gemini://example.org/ Example\n* item\n>quote\n"
+                               "```alt\nline 1\r\n\nline 3\n```\ntext";
+    const auto nodes = parseGeminiNodes(source);
+    REQUIRE(nodes.size() == 6);
+    CHECK(nodes[0].type == GeminiNodeType::Heading1);
+    CHECK(nodes[0].text == "Title");
+    CHECK(nodes[0].orig_text == "# Title ");
+    CHECK(nodes[1].type == GeminiNodeType::Link);
+    CHECK(nodes[1].meta == "gemini://example.org/");
+    CHECK(nodes[1].text == "Example");
+    CHECK(nodes[2].type == GeminiNodeType::List);
+    CHECK(nodes[3].type == GeminiNodeType::Quote);
+    CHECK(nodes[4].type == GeminiNodeType::PreformattedText);
+    CHECK(nodes[4].meta == "alt");
+    CHECK(nodes[4].text == "line 1\r\n\nline 3\n");
+    CHECK(nodes[4].orig_text == "```alt\nline 1\r\n\nline 3\n```");
+    CHECK(nodes[5].type == GeminiNodeType::Text);
+
+    // The copying API reports the same nodes
+    const auto ast = parseGemini(source);
+    REQUIRE(ast.size() == nodes.size());
+    for(std::size_t i = 0; i < ast.size(); i++) {
+        CHECK(ast[i].type == nodeTypeName(nodes[i].type));
+        CHECK(ast[i].text == nodes[i].text);
+        CHECK(ast[i].meta == nodes[i].meta);
+        CHECK(ast[i].orig_text == nodes[i].orig_text);
+    }
+
+    // Documents keep their nodes valid when moved
+    GeminiDocument document(source);
+    const auto moved = std::move(document);
+    REQUIRE(moved.size() == nodes.size());
+    CHECK(moved[1].meta == "gemini://example.org/");
+    CHECK(moved[4].text.data() >= moved.source().data());
+}
+
+DROGON_TEST(GeminiRendererSinks)
+{
+    const std::string source = "# A <title>\n## Section\n## Section\ntext with **bold**\n---\n"
+                               "=> gemini://example.org/ Example\n=> /photo.png A photo\n=> /search?term\n"
+                               "=> https://youtu.be/abc?t=5 Video\n* one\n* two\n> quote\n> more\n"
+                               "```md\n| a | b |\n|---|---|\n| 1 | 2 |\n| 3 | 4 |\n```\n```cpp\nint main() {}\n```\n";
+    for(const bool extended : {false, true}) {
+        const auto [html, title] = render2Html(source, extended);
+        CHECK(title == "A &lt;title&gt;");
+
+        std::string streamed = "<body>";
+        StringHtmlSink sink(streamed);
+        CHECK(render2Html(source, sink, extended) == title);
+        CHECK(streamed == "<body>" + html);
+
+        std::string joined;
+        std::size_t chunks = 0;
+        ChunkedHtmlSink chunked([&](std::string_view chunk) {
+            CHECK(!chunk.empty());
+            joined += chunk;
+            chunks++;
+        }, 64);
+        render2Html(parseGeminiNodes(source), chunked, extended);
+        CHECK(joined == html);
+        CHECK(chunks > 1);
+    }
+}
@@ -0,0 +1,160 @@
+#include <dremini/GeminiUrl.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace dremini;
+
+DROGON_TEST(GeminiUrlParsing)
+{
+    const auto full = parseGeminiUrl("gemini://example.org:1966/a/b?c=d#frag");
+    REQUIRE(full);
+    CHECK(full->scheme == "gemini");
+    CHECK(full->authority == "example.org:1966");
+    CHECK(full->host == "example.org");
+    CHECK(full->port == "1966");
+    CHECK(full->portNumber == 1966);
+    CHECK(full->path == "/a/b");
+    CHECK(full->query == "c=d");
+    CHECK(full->fragment == "frag");
+
+    const auto bare = parseGeminiUrl("gemini://example.org");
+    REQUIRE(bare);
+    CHECK(bare->path.empty());
+    CHECK(bare->portOr(1965) == 1965);
+    CHECK(bare->hasQuery == false);
+
+    const auto emptyQuery = parseGeminiUrl("gemini://example.org/?");
+    REQUIRE(emptyQuery);
+    CHECK(emptyQuery->hasQuery);
+    CHECK(emptyQuery->query.empty());
+
+    const auto queryOnly = parseGeminiUrl("gemini://example.org?search");
+    REQUIRE(queryOnly);
+    CHECK(queryOnly->path.empty());
+    CHECK(queryOnly->query == "search");
+
+    const auto ipv6 = parseGeminiUrl("gemini://[::1]:1965/");
+    REQUIRE(ipv6);
+    CHECK(ipv6->ipv6Host);
+    CHECK(ipv6->host == "::1");
+    CHECK(ipv6->authority == "[::1]:1965");
+
+    const auto titan = parseGeminiUrl("TITAN://example.org/upload;mime=text/plain;size=10");
+    REQUIRE(titan);
+    CHECK(titan->hasScheme("titan"));
+    CHECK(titan->path == "/upload;mime=text/plain;size=10");
+
+    const auto emptyPort = parseGeminiUrl("gemini://example.org:/");
+    REQUIRE(emptyPort);
+    CHECK(emptyPort->port.empty());
+    CHECK(emptyPort->portOr(1965) == 1965);
+
+    CHECK(!parseGeminiUrl(""));
+    CHECK(!parseGeminiUrl("gemini:/example.org/"));
+    CHECK(!parseGeminiUrl("://example.org/"));
+    CHECK(!parseGeminiUrl("1gemini://example.org/"));
+    CHECK(!parseGeminiUrl("gemini:///path"));
+    CHECK(!parseGeminiUrl("gemini://user@example.org/"));
+    CHECK(!parseGeminiUrl("gemini://example.org:65536/"));
+    CHECK(!parseGeminiUrl("gemini://example.org:19a5/"));
+    CHECK(!parseGeminiUrl("gemini://[::1/"));
+    CHECK(!parseGeminiUrl("gemini://[example]/"));
+    CHECK(!parseGeminiUrl("gemini://example.org/a b"));
+    CHECK(!parseGeminiUrl("gemini://example.org/%zz"));
+    CHECK(!parseGeminiUrl("gemini://example.org/%2"));
+    CHECK(!parseGeminiUrl("gemini://example.org/\r"));
+    CHECK(!parseGeminiUrl(std::string_view("gemini://example.org/\0", 22)));
+}
+
+// Mutation fuzzing from a seed corpus. Whatever the input, an accepted URL
+// must reassemble into exactly the input, and every URL the previous
+// regex-based server parser accepted must still parse to the same parts.
+DROGON_TEST(GeminiUrlFuzzCorpus)
+{
+    static const std::regex legacy(R"(([a-z]+):\/\/([^\/:]+)(?:\:([0-9]+))?(\/$|$|\/[^?]*)(?:\?(.*))?)");
+    const std::vector<std::string> seeds{
+        "gemini://example.org/",
+        "gemini://example.org:1965/index.gmi",
+        "gemini://127.0.0.1/apitest2?hello",
+        "gemini://[::1]:1965/a%20b?q%3D1",
+        "titan://example.org/mail/draft;mime=text/plain;size=12",
+        "gemini://example.org/~user/dir/?q#frag",
+    };
+    const std::string alphabet = "az09:/?#[]@%.;=-_~ \r\n\"<>{}|\\^`\x80\xff";
+
+    std::mt19937 rng(1965);
+    std::size_t legacyMatches = 0;
+    for (std::size_t iteration = 0; iteration < 20000; ++iteration)
+    {
+        std::string input = seeds[rng() % seeds.size()];
+        const auto mutations = 1 + rng() % 4;
+        for (std::size_t mutation = 0; mutation < mutations; ++mutation)
+        {
+            const auto position = input.empty() ? 0 : rng() % input.size();
+            const auto character = alphabet[rng() % alphabet.size()];
+            switch (rng() % 3)
+            {
+            case 0: input.insert(input.begin() + position, character); break;
+            case 1: if (!input.empty()) input.erase(input.begin() + position); break;
+            default: if (!input.empty()) input[position] = character; break;
+            }
+        }
+
+        const auto parsed = parseGeminiUrl(input);
+        if (parsed)
+        {
+            std::string rebuilt = std::string(parsed->scheme) + "://" + std::string(parsed->authority) +
+                                  std::string(parsed->path);
+            if (parsed->hasQuery) rebuilt += "?" + std::string(parsed->query);
+            if (parsed->hasFragment) rebuilt += "#" + std::string(parsed->fragment);
+            CHECK(rebuilt == input);
+            CHECK(!parsed->host.empty());
+        }
+
+        std::smatch match;
+        if (!std::regex_match(input, match, legacy)) continue;
+        // The legacy regex accepted characters RFC 3986 forbids, userinfo and
+        // fragments. Only compare inputs that are valid for both parsers.
+        if (input.find_first_of(" \"<>{}|\\^`@#[]%\r\n") != std::string::npos) continue;
+        if (input.find_first_of("\x80\xff") != std::string::npos) continue;
+        if (match[2].str().find('?') != std::string::npos) continue;
+        if (match[3].length() > 5 || (match[3].matched && std::stoi(match[3].str()) > 65535)) continue;
+        ++legacyMatches;
+        REQUIRE(parsed);
+        CHECK(parsed->scheme == match[1].str());
+        CHECK(parsed->host == match[2].str());
+        CHECK(parsed->port == match[3].str());
+        CHECK(parsed->path == match[4].str());
+        CHECK(parsed->query == match[5].str());
+    }
+    CHECK(legacyMatches > 0);
+}
+
+DROGON_TEST(GeminiUrlResolution)
+{
+    const std::string base = "gemini://example.org/a/b/c?q#f";
+    CHECK(resolveGeminiUrl(base, "gemini://other.org/x") == "gemini://other.org/x");
+    CHECK(resolveGeminiUrl(base, "https://other.org/x") == "https://other.org/x");
+    CHECK(resolveGeminiUrl(base, "//other.org/x") == "gemini://other.org/x");
+    CHECK(resolveGeminiUrl(base, "/x/y") == "gemini://example.org/x/y");
+    CHECK(resolveGeminiUrl(base, "d") == "gemini://example.org/a/b/d");
+    CHECK(resolveGeminiUrl(base, "./d/") == "gemini://example.org/a/b/d/");
+    CHECK(resolveGeminiUrl(base, "../d") == "gemini://example.org/a/d");
+    CHECK(resolveGeminiUrl(base, "../../../../d") == "gemini://example.org/d");
+    CHECK(resolveGeminiUrl(base, "..") == "gemini://example.org/a/");
+    CHECK(resolveGeminiUrl(base, "/x/./y/../z") == "gemini://example.org/x/z");
+    CHECK(resolveGeminiUrl(base, "?r") == "gemini://example.org/a/b/c?r");
+    CHECK(resolveGeminiUrl(base, "") == "gemini://example.org/a/b/c?q");
+    CHECK(resolveGeminiUrl(base, "d#frag") == "gemini://example.org/a/b/d");
+    CHECK(resolveGeminiUrl("gemini://example.org", "d") == "gemini://example.org/d");
+    CHECK(resolveGeminiUrl("gemini://[::1]:1966/a", "b") == "gemini://[::1]:1966/b");
+
+    CHECK(!resolveGeminiUrl("not a url", "/x"));
+    CHECK(!resolveGeminiUrl(base, "mailto:someone@example.org"));
+    CHECK(!resolveGeminiUrl(base, "/a b"));
+}
@@ -0,0 +1,49 @@
+#include <dremini/Metrics.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dremini;
+using namespace std::chrono_literals;
+
+DROGON_TEST(ShardedMetrics)
+{
+    ServerMetrics metrics;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&metrics]() {
+            for (int j = 0; j < 1000; j++)
+            {
+                metrics.connectionsAccepted.add();
+                metrics.titanBytesReceived.add(3);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    CHECK(metrics.connectionsAccepted.value() == 8000);
+    CHECK(metrics.titanBytesReceived.value() == 24000);
+
+    metrics.handlerLatency.observe(5us);
+    metrics.handlerLatency.observe(2ms);
+    metrics.handlerLatency.observe(1min);
+    const auto snapshot = metrics.handlerLatency.snapshot();
+    CHECK(snapshot.count == 3);
+    CHECK(snapshot.buckets.front() == 1);
+    CHECK(snapshot.buckets.back() == 1);
+    CHECK(snapshot.sumSeconds > 60.0);
+    CHECK(snapshot.sumSeconds < 60.01);
+
+    metrics.responses[1].add();
+    const auto text = renderPrometheusText(metrics);
+    CHECK(text.find("# TYPE dremini_connections_accepted_total counter\n") != std::string::npos);
+    CHECK(text.find("dremini_connections_accepted_total 8000\n") != std::string::npos);
+    CHECK(text.find("dremini_responses_total{class=\"2x\"} 1\n") != std::string::npos);
+    CHECK(text.find("dremini_handler_latency_seconds_bucket{le=\"1e-05\"} 1\n") != std::string::npos);
+    CHECK(text.find("dremini_handler_latency_seconds_bucket{le=\"+Inf\"} 3\n") != std::string::npos);
+    CHECK(text.find("dremini_handler_latency_seconds_count 3\n") != std::string::npos);
+}
@@ -0,0 +1,50 @@
+#include <dremini/RateLimiter.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <string>
+
+using namespace dremini;
+using namespace std::chrono_literals;
+
+DROGON_TEST(PeerRateLimiter)
+{
+    PeerRateLimiter limiter(2.0, 3.0);
+    const auto start = PeerRateLimiter::Clock::time_point{} + 1h;
+
+    // A new peer may burst, then has to wait for tokens to refill
+    CHECK(limiter.acquire("192.0.2.1", start) == 0);
+    CHECK(limiter.acquire("192.0.2.1", start) == 0);
+    CHECK(limiter.acquire("192.0.2.1", start) == 0);
+    const auto wait = limiter.acquire("192.0.2.1", start);
+    CHECK(wait > 0.49);
+    CHECK(wait < 0.51);
+
+    // Other peers are unaffected
+    CHECK(limiter.acquire("192.0.2.2", start) == 0);
+
+    CHECK(limiter.acquire("192.0.2.1", start + 500ms) == 0);
+    CHECK(limiter.acquire("192.0.2.1", start + 500ms) > 0);
+
+    // Refill is capped at the burst size
+    const auto later = start + 1h;
+    for (int i = 0; i < 3; ++i)
+        CHECK(limiter.acquire("192.0.2.1", later) == 0);
+    CHECK(limiter.acquire("192.0.2.1", later) > 0);
+
+    // Many distinct peers keep working once shards start evicting, while a
+    // peer that keeps coming back is not forgotten and stays throttled
+    int refused = 0;
+    int busyAdmitted = 0;
+    for (int i = 0; i < 300000; ++i)
+    {
+        refused += limiter.acquire("198.51.100." + std::to_string(i), later) != 0;
+        if (i % 1000 == 0) busyAdmitted += limiter.acquire("192.0.2.1", later) == 0;
+    }
+    CHECK(refused == 0);
+    CHECK(busyAdmitted == 0);
+
+    // Evicted peers start again with a full bucket
+    for (int i = 0; i < 3; ++i)
+        CHECK(limiter.acquire("198.51.100.0", later) == 0);
+}
@@ -0,0 +1,65 @@
+#include <dremini/ResponseCache.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <memory>
+#include <string>
+
+using namespace dremini;
+using namespace std::chrono_literals;
+
+namespace
+{
+std::shared_ptr<const std::string> response(std::string bytes)
+{
+    return std::make_shared<const std::string>(std::move(bytes));
+}
+}  // namespace
+
+DROGON_TEST(ResponseCache)
+{
+    ResponseCache cache(16 * 1024);
+    const auto now = ResponseCache::Clock::time_point{} + 1h;
+
+    cache.insert("example.org", "/a", "", response("20 text/gemini\r\n# A"), 10s, now);
+    cache.insert("example.org", "/a", "q", response("20 text/gemini\r\n# A?q"), 10s, now);
+    cache.insert("example.org", "/b", "", response("20 text/gemini\r\n# B"), 10s, now);
+    REQUIRE(cache.find("example.org", "/a", "", now) != nullptr);
+    CHECK(*cache.find("example.org", "/a", "", now) == "20 text/gemini\r\n# A");
+    CHECK(*cache.find("example.org", "/a", "q", now) == "20 text/gemini\r\n# A?q");
+    CHECK(cache.find("example.com", "/a", "", now) == nullptr);
+
+    // Entries expire after their TTL
+    CHECK(cache.find("example.org", "/b", "", now + 10s) == nullptr);
+
+    // Invalidating a path drops it for every query but leaves other paths
+    cache.insert("example.org", "/b", "", response("20 text/gemini\r\n# B"), 10s, now);
+    cache.insert("example.org", "/ab", "", response("20 text/gemini\r\n# AB"), 10s, now);
+    cache.invalidate("/a");
+    CHECK(cache.find("example.org", "/a", "", now) == nullptr);
+    CHECK(cache.find("example.org", "/a", "q", now) == nullptr);
+    CHECK(cache.find("example.org", "/b", "", now) != nullptr);
+    CHECK(cache.find("example.org", "/ab", "", now) != nullptr);
+
+    // Zero TTLs and responses over the budget are not stored
+    cache.insert("example.org", "/c", "", response("20 text/gemini\r\n"), 0s, now);
+    CHECK(cache.find("example.org", "/c", "", now) == nullptr);
+    cache.insert("example.org", "/c", "", response(std::string(4096, 'x')), 10s, now);
+    CHECK(cache.find("example.org", "/c", "", now) == nullptr);
+
+    cache.clear();
+    CHECK(cache.sizeBytes() == 0);
+}
+
+DROGON_TEST(ResponseCacheEviction)
+{
+    // One path always lands in the same shard, whose budget is 1/16th
+    ResponseCache cache(16 * 100);
+    const auto now = ResponseCache::Clock::time_point{} + 1h;
+    for (int i = 0; i < 10; i++)
+        cache.insert("example.org", "/page", std::to_string(i), response(std::string(30, 'x')), 10s, now);
+    CHECK(cache.sizeBytes() <= 16 * 100);
+    // The most recent entries survive, the oldest were evicted
+    CHECK(cache.find("example.org", "/page", "9", now) != nullptr);
+    CHECK(cache.find("example.org", "/page", "0", now) == nullptr);
+}
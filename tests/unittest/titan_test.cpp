@@ -1,7 +1,14 @@
 #include <dremini/Titan.hpp>
 
+#include <drogon/HttpRequest.h>
 #include <drogon/drogon_test.h>
 
+#include <filesystem>
+#include <future>
+#include <iterator>
+#include <fstream>
+#include <sstream>
+
 using namespace dremini;
 
 DROGON_TEST(TitanRequestParsing)
@@ -42,3 +49,71 @@ DROGON_TEST(TitanRequestParsing)
     CHECK(parseTitanRequest("/mail/draft;edit;size=0", 64).error == TitanParseError::ConflictingOperation);
     CHECK(parseTitanRequest("/mail/draft;size=1;unknown=value", 64).error == TitanParseError::InvalidParameter);
 }
+
+DROGON_TEST(TitanUploadSinks)
+{
+    auto memoryRequest = drogon::HttpRequest::newHttpRequest();
+    auto memory = newTitanMemorySink();
+    REQUIRE(memory->write("hello "));
+    REQUIRE(memory->write("titan"));
+    REQUIRE(memory->finish(*memoryRequest));
+    CHECK(memoryRequest->body() == "hello titan");
+
+    const auto directory = std::filesystem::temp_directory_path() / "dremini-titan-test";
+    auto fileRequest = drogon::HttpRequest::newHttpRequest();
+    auto spool = newTitanFileSink(directory.string());
+    REQUIRE(spool->write("hello "));
+    REQUIRE(spool->write("titan"));
+    REQUIRE(spool->finish(*fileRequest));
+    spool.reset();
+    CHECK(fileRequest->body().empty());
+
+    auto file = fileRequest->getAttributes()->get<std::shared_ptr<TitanUploadFile>>(kTitanUploadFileAttribute);
+    REQUIRE(file != nullptr);
+    CHECK(file->size() == 11);
+    const auto path = file->path();
+    {
+        std::ifstream stream(path, std::ios::binary);
+        std::stringstream content;
+        content << stream.rdbuf();
+        CHECK(content.str() == "hello titan");
+    }
+    file.reset();
+    fileRequest.reset();
+    CHECK(!std::filesystem::exists(path));
+
+    // Finishing asynchronously attaches the file once everything queued
+    // before it has been written, however congested the sink got
+    auto asyncRequest = drogon::HttpRequest::newHttpRequest();
+    auto async = newTitanFileSink(directory.string());
+    const std::string block(64 * 1024, 'x');
+    for (int i = 0; i < 32; ++i)
+        REQUIRE(async->write(block));
+    std::promise<void> drained;
+    async->whenDrained([&drained]() { drained.set_value(); });
+    drained.get_future().wait();
+    std::promise<bool> stored;
+    async->finishAsync(*asyncRequest, [&stored](bool ok) { stored.set_value(ok); });
+    CHECK(stored.get_future().get());
+    auto asyncFile = asyncRequest->getAttributes()->get<std::shared_ptr<TitanUploadFile>>(kTitanUploadFileAttribute);
+    REQUIRE(asyncFile != nullptr);
+    CHECK(asyncFile->size() == 32 * block.size());
+    CHECK(std::filesystem::file_size(asyncFile->path()) == 32 * block.size());
+    asyncFile.reset();
+    async.reset();
+    asyncRequest.reset();
+
+    // An abandoned upload leaves nothing behind. File sinks share one spool
+    // thread, so once a later upload has finished the abandoned file is gone.
+    auto abandoned = newTitanFileSink(directory.string());
+    REQUIRE(abandoned->write("partial"));
+    abandoned.reset();
+    auto laterRequest = drogon::HttpRequest::newHttpRequest();
+    auto later = newTitanFileSink(directory.string());
+    REQUIRE(later->finish(*laterRequest));
+    CHECK(std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()) == 1);
+    later.reset();
+    laterRequest.reset();
+    CHECK(std::filesystem::is_empty(directory));
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,89 @@
+#include <dremini/TofuStore.hpp>
+
+#include <drogon/drogon_test.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace dremini;
+using namespace std::chrono_literals;
+
+namespace
+{
+std::size_t countLines(const std::string& path)
+{
+    std::ifstream in(path);
+    std::size_t lines = 0;
+    std::string line;
+    while (std::getline(in, line))
+        lines++;
+    return lines;
+}
+}  // namespace
+
+DROGON_TEST(TofuStoreVerdicts)
+{
+    TofuOptions options;
+    options.pinLifetime = 1h;
+    TofuStore store("", options);
+    const auto now = TofuStore::Clock::now();
+
+    CHECK(store.check("example.org:1965", "AA", now) == TofuStore::Verdict::Pinned);
+    CHECK(store.check("example.org:1965", "AA", now + 1min) == TofuStore::Verdict::Matched);
+    CHECK(store.check("example.org:1965", "BB", now + 1min) == TofuStore::Verdict::Mismatch);
+    // Pins are per endpoint
+    CHECK(store.check("example.org:1966", "BB", now) == TofuStore::Verdict::Pinned);
+    CHECK(store.size() == 2);
+
+    // An expired pin is replaced by the next certificate seen
+    CHECK(store.check("example.org:1965", "BB", now + 2h) == TofuStore::Verdict::Pinned);
+    CHECK(store.check("example.org:1965", "AA", now + 2h) == TofuStore::Verdict::Mismatch);
+
+    store.pin("example.org:1965", "CC", now + 2h);
+    CHECK(store.check("example.org:1965", "CC", now + 2h) == TofuStore::Verdict::Matched);
+    store.forget("example.org:1965");
+    CHECK(!store.find("example.org:1965"));
+    CHECK(store.check("example.org:1965", "DD", now + 2h) == TofuStore::Verdict::Pinned);
+}
+
+DROGON_TEST(TofuStorePersistence)
+{
+    const std::string path = "tofu_store_test.txt";
+    std::remove(path.c_str());
+    TofuOptions options;
+    options.compactAfter = 4;
+    const auto now = TofuStore::Clock::now();
+
+    {
+        TofuStore store(path, options);
+        store.check("a:1965", "AA", now);
+        store.check("b:1965", "BB", now);
+        store.check("c:1965", "CC", now);
+        store.forget("c:1965");
+        store.flush();
+        CHECK(countLines(path) == 4);
+    }
+
+    {
+        TofuStore store(path, options);
+        CHECK(store.size() == 2);
+        REQUIRE(store.find("a:1965").has_value());
+        CHECK(store.find("a:1965")->fingerprint == "AA");
+        CHECK(!store.find("c:1965"));
+        CHECK(store.check("b:1965", "XX", now) == TofuStore::Verdict::Mismatch);
+
+        // Superseded records are dropped once they pile up
+        for (int i = 0; i < 10; i++)
+            store.pin("a:1965", "A" + std::to_string(i), now);
+        store.flush();
+        CHECK(countLines(path) < 2 + options.compactAfter + 1);
+    }
+
+    TofuStore store(path, options);
+    CHECK(store.size() == 2);
+    CHECK(store.find("a:1965")->fingerprint == "A9");
+    CHECK(store.find("b:1965")->fingerprint == "BB");
+    std::remove(path.c_str());
+}